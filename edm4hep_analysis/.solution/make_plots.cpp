@@ -0,0 +1,111 @@
+#include <TFile.h>
+
+#include "podio/Frame.h"
+#include "podio/Reader.h"
+
+#include "edm4hep/ReconstructedParticleCollection.h"
+#include "edm4hep/utils/kinematics.h"
+
+#include "GaudiKinfit/Histograms.h"
+#include "GaudiKinfit/HistogramsROOT.h"
+#include "GaudiKinfit/IncrementalCache.h"
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hist = kinfit::hist;
+
+/// Increase whenever the way the histograms are filled changes, to invalidate
+/// the results in existing caches (changes to the booking are detected
+/// automatically)
+constexpr int fillVersion = 1;
+
+/// The histograms, they are only converted to ROOT histograms at the end
+struct HiggsRecoilHistograms {
+  hist::Histogram1D z_mass{"z_mass", ";Mass / GeV;Entries", {240, 60.0, 120.0}};
+  hist::Histogram1D recoil_mass{"recoil_mass", ";Mass / GeV;Entries", {380, 60.0, 250.0}};
+};
+
+/// The definitions of the histograms for the IncrementalCache
+std::string histogramDefinitions() {
+  const auto histograms = HiggsRecoilHistograms{};
+  auto definitions = std::ostringstream{};
+  definitions << "fill_version " << fillVersion << '\n';
+  hist::writeHistograms(definitions, histograms.z_mass, histograms.recoil_mass);
+  return definitions.str();
+}
+
+std::vector<hist::AnyHistogram> fillHistograms(const std::string& inputfile) {
+  const auto e_cms = edm4hep::LorentzVectorE(0, 0, 0, 250.);
+
+  auto reader = podio::makeReader(inputfile);
+
+  auto [z_mass, recoil_mass] = HiggsRecoilHistograms{};
+
+  for (size_t i = 0; i < reader.getEntries("events"); ++i) {
+    const auto event = reader.readEvent(i);
+
+    const auto& muons = event.get<edm4hep::ReconstructedParticleCollection>("Muons");
+    if (muons.size() != 2) {
+      continue;
+    }
+
+    const auto z_p4 = edm4hep::utils::p4(muons[0]) + edm4hep::utils::p4(muons[1]);
+    z_mass.fill(z_p4.M());
+    recoil_mass.fill((e_cms - z_p4).M());
+  }
+
+  auto histograms = std::vector<hist::AnyHistogram>{};
+  histograms.emplace_back(std::move(z_mass));
+  histograms.emplace_back(std::move(recoil_mass));
+  return histograms;
+}
+
+int main(int argc, char* argv[]) {
+  const bool incremental = argc > 1 && std::strcmp(argv[1], "--cache-dir") == 0;
+  const bool prune = incremental && argc > 3 && std::strcmp(argv[3], "--prune") == 0;
+  // Index of the output file, followed by the input files
+  const int firstArg = incremental ? 3 + prune : 1;
+  if (argc < firstArg + 2) {
+    std::cerr << "Usage: " << argv[0] << " <outputfile> <inputfiles...>\n"
+              << "       " << argv[0] << " --cache-dir <cachedir> [--prune] <outputfile> <inputfiles...>\n\n"
+              << "With --cache-dir the partial histograms of every input file are cached together with a\n"
+              << "checksum of the file, and only new or changed input files are processed on a re-run.\n"
+              << "With --prune all cached results of files that are not passed in this run are removed"
+              << std::endl;
+    return 1;
+  }
+
+  const std::string outputfile = argv[firstArg];
+  const auto inputfiles = std::vector<std::string>(argv + firstArg + 1, argv + argc);
+
+  auto histograms = std::vector<hist::AnyHistogram>{};
+  if (!incremental) {
+    for (const auto& inputfile : inputfiles) {
+      hist::mergeHistograms(histograms, fillHistograms(inputfile));
+    }
+  } else {
+    auto cache = IncrementalCache(argv[2], histogramDefinitions());
+    if (cache.invalidated()) {
+      std::cout << "The histogram definitions have changed, dropped all cached results in " << argv[2] << std::endl;
+    }
+    for (const auto& inputfile : inputfiles) {
+      hist::mergeHistograms(histograms, cache.get(inputfile, fillHistograms));
+    }
+    cache.writeManifest(inputfiles, prune);
+    std::cout << "Processed " << cache.nProcessed() << " new or changed files and reused " << cache.nCached()
+              << " cached results" << std::endl;
+  }
+
+  auto histfile = std::make_unique<TFile>(outputfile.c_str(), "recreate");
+  hist::writeToROOT(histograms);
+  histfile->Close();
+
+  std::cout << "Analysis complete. Output written to " << outputfile << std::endl;
+
+  return 0;
+}
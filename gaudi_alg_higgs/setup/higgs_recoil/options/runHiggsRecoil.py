@@ -20,20 +20,38 @@
 from Gaudi.Configuration import INFO
 from Configurables import HiggsRecoil, MuonFilter
 from k4FWCore import ApplicationMgr, IOSvc
+from k4FWCore.parseArgs import parser
+
+parser.add_argument("--async-output", action="store_true",
+                    help="Write the output from a separate thread with the AsyncOutputWriter. "
+                    "Requires the GaudiKinfit plugins of the gaudi_alg_kinfit solution in the environment")
+opts = parser.parse_known_args()[0]
 
 iosvc = IOSvc()
 iosvc.Input = "rv02-02.sv02-02.mILD_l5_o1_v02.E250-SetA.I402004.Pe2e2h.eR.pL.n000.d_dstm_15090_0.edm4hep.root"
 iosvc.CollectionNames = [
     "PandoraPFOs",
 ]
-iosvc.Output = "higgs_recoil_out.root"
-iosvc.outputCommands = [
-    "drop *",
-    "keep Muons",
-    "keep PandoraPFOs",
-    "keep Z",
-    "keep Higgs",
+
+# The collections that are written to the output file
+output_collections = [
+    "Muons",
+    "PandoraPFOs",
+    "Z",
+    "Higgs",
 ]
+output_algs = []
+if opts.async_output:
+    # The AsyncOutputWriter is part of the gaudi_alg_kinfit solution, it copies
+    # the events and writes them on a separate thread
+    from Configurables import AsyncOutputWriter
+    output_algs.append(AsyncOutputWriter("AsyncOutputWriter",
+                                         InputCollections=output_collections,
+                                         MCParticleCollections=[],
+                                         OutputFile="higgs_recoil_out.root"))
+else:
+    iosvc.Output = "higgs_recoil_out.root"
+    iosvc.outputCommands = ["drop *"] + [f"keep {name}" for name in output_collections]
 
 # The collections that we don't drop will be present in the output file
 # iosvc.outputCommands = ["drop Collection1"]
@@ -51,7 +69,7 @@ recoil = HiggsRecoil("HiggsRecoil",
                      ZCollection=["Z"],
                      )
 
-ApplicationMgr(TopAlg=[muon, recoil],
+ApplicationMgr(TopAlg=[muon, recoil] + output_algs,
                EvtSel="NONE",
                EvtMax=-1,
                ExtSvc=[iosvc],
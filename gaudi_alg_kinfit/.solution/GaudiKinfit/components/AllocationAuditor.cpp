@@ -0,0 +1,131 @@
+#include "AllocationAuditor.hpp"
+
+#include <GaudiKernel/ThreadLocalContext.h>
+
+#include <fmt/format.h>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+/// The allocation counts at the start of the currently running algorithms of
+/// this thread. A stack, since algorithms (sequences) can be nested
+thread_local std::vector<KinfitAllocationCounts> t_startCounts;
+
+/// Current resident set size of the process in kB
+std::uint64_t residentSetSizeKB() {
+  auto* statm = std::fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  unsigned long size{}, resident{};
+  const auto nRead = std::fscanf(statm, "%lu %lu", &size, &resident);
+  std::fclose(statm);
+  return nRead == 2 ? resident * sysconf(_SC_PAGESIZE) / 1024 : 0;
+}
+} // namespace
+
+AllocationAuditor::AllocationAuditor(const std::string& name, ISvcLocator* svcLoc)
+    : AllocationAuditorBase(name, svcLoc) {}
+
+StatusCode AllocationAuditor::initialize() {
+  auto sc = AllocationAuditorBase::initialize();
+  if (sc.isFailure()) {
+    return sc;
+  }
+
+  m_allocationCounts = reinterpret_cast<KinfitAllocationCountsFunc>(dlsym(RTLD_DEFAULT, KinfitAllocationCountsSymbol));
+  if (!m_allocationCounts) {
+    warning() << "libKinfitAllocationCounter.so has not been preloaded (LD_PRELOAD), only the RSS will be recorded"
+              << endmsg;
+  }
+
+  if (!m_traceFile.value().empty()) {
+    m_trace.open(m_traceFile.value());
+    if (!m_trace) {
+      error() << "Could not open allocation trace file " << m_traceFile.value() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_trace << "event,algorithm,nAllocs,nFrees,bytes,rssKB\n";
+  }
+
+  return StatusCode::SUCCESS;
+}
+
+#if GAUDI_MAJOR_VERSION < 39
+void AllocationAuditor::beforeExecute(INamedInterface*) { start(); }
+
+void AllocationAuditor::afterExecute(INamedInterface* alg, const StatusCode&) {
+  stop(alg->name(), Gaudi::Hive::currentContext().evt());
+}
+#else
+void AllocationAuditor::before(std::string const& event, std::string const&, EventContext const&) {
+  if (event == IAuditor::Execute) {
+    start();
+  }
+}
+
+void AllocationAuditor::after(std::string const& event, std::string const& caller, EventContext const& context,
+                              StatusCode const&) {
+  if (event == IAuditor::Execute) {
+    stop(caller, context.evt());
+  }
+}
+#endif
+
+void AllocationAuditor::start() {
+  t_startCounts.push_back(m_allocationCounts ? m_allocationCounts() : KinfitAllocationCounts{0, 0, 0});
+}
+
+void AllocationAuditor::stop(const std::string& algName, std::uint64_t eventNumber) {
+  // Take the counts first to not count any of the allocations done here
+  const auto end = m_allocationCounts ? m_allocationCounts() : KinfitAllocationCounts{0, 0, 0};
+  if (t_startCounts.empty()) {
+    return;
+  }
+  const auto begin = t_startCounts.back();
+  t_startCounts.pop_back();
+
+  const auto nAllocs = end.nAllocs - begin.nAllocs;
+  const auto nFrees = end.nFrees - begin.nFrees;
+  const auto bytes = end.bytes - begin.bytes;
+  const auto rss = residentSetSizeKB();
+
+  std::lock_guard lock(m_mutex);
+  auto& stats = m_stats[algName];
+  stats.nCalls++;
+  stats.nAllocs += nAllocs;
+  stats.bytes += bytes;
+  stats.maxBytes = std::max(stats.maxBytes, bytes);
+
+  if (m_trace.is_open()) {
+    m_trace << fmt::format("{},{},{},{},{},{}\n", eventNumber, algName, nAllocs, nFrees, bytes, rss);
+  }
+}
+
+StatusCode AllocationAuditor::finalize() {
+  info() << "Heap allocations per algorithm (RSS at finalize " << residentSetSizeKB() / 1024 << " MB)\n"
+         << fmt::format("{:<40} {:>10} {:>14} {:>14} {:>14} {:>14}", "Algorithm", "Calls", "Allocs/call",
+                        "kB/call", "Max kB/call", "Total MB");
+  for (const auto& [name, stats] : m_stats) {
+    const auto nCalls = std::max<std::uint64_t>(stats.nCalls, 1);
+    info() << '\n'
+           << fmt::format("{:<40} {:>10} {:>14.1f} {:>14.2f} {:>14.2f} {:>14.2f}", name, stats.nCalls,
+                          double(stats.nAllocs) / nCalls, stats.bytes / 1024.0 / nCalls, stats.maxBytes / 1024.0,
+                          stats.bytes / 1024.0 / 1024.0);
+  }
+  info() << endmsg;
+
+  if (m_trace.is_open()) {
+    m_trace.close();
+    info() << "Per event allocation trace written to " << m_traceFile.value() << endmsg;
+  }
+
+  return AllocationAuditorBase::finalize();
+}
+
+DECLARE_COMPONENT(AllocationAuditor)
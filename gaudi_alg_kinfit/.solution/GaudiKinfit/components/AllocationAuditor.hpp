@@ -0,0 +1,70 @@
+#pragma once
+
+#include "GaudiKinfit/AllocationCounter.h"
+
+#include <GAUDI_VERSION.h>
+#if GAUDI_MAJOR_VERSION < 39
+#include <GaudiKernel/Auditor.h>
+#else
+#include <Gaudi/Auditor.h>
+#endif
+#include <Gaudi/Property.h>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+// The auditor interface has been reworked in Gaudi v39
+#if GAUDI_MAJOR_VERSION < 39
+using AllocationAuditorBase = Auditor;
+#else
+using AllocationAuditorBase = Gaudi::Auditor;
+#endif
+
+/// Auditor recording the number of heap allocations and allocated bytes for
+/// every algorithm in every event, as well as the resident set size (RSS) of
+/// the process after each algorithm has run.
+///
+/// Allocations are counted by the KinfitAllocationCounter library, which has
+/// to be preloaded (see GaudiKinfit/AllocationCounter.h). Without it only the
+/// RSS is recorded. Counts are per thread and inclusive, i.e. a sequence
+/// includes the allocations of all algorithms it runs.
+///
+/// A summary table is printed in finalize, and a per event trace is written
+/// to a csv file.
+struct AllocationAuditor final : public AllocationAuditorBase {
+  AllocationAuditor(const std::string& name, ISvcLocator* svcLoc);
+
+  StatusCode initialize() override;
+  StatusCode finalize() override;
+
+#if GAUDI_MAJOR_VERSION < 39
+  void beforeExecute(INamedInterface* alg) override;
+  void afterExecute(INamedInterface* alg, const StatusCode& sc) override;
+#else
+  void before(std::string const& event, std::string const& caller, EventContext const& context) override;
+  void after(std::string const& event, std::string const& caller, EventContext const& context,
+             StatusCode const& sc) override;
+#endif
+
+private:
+  Gaudi::Property<std::string> m_traceFile{this, "TraceFile", "",
+                                           "File for the per event and algorithm trace. Nothing is written if empty"};
+
+  void start();
+  void stop(const std::string& algName, std::uint64_t eventNumber);
+
+  struct AlgStats {
+    std::uint64_t nCalls{};
+    std::uint64_t nAllocs{};
+    std::uint64_t bytes{};
+    std::uint64_t maxBytes{};
+  };
+
+  KinfitAllocationCountsFunc m_allocationCounts{nullptr};
+  std::mutex m_mutex;
+  std::map<std::string, AlgStats> m_stats;
+  std::ofstream m_trace;
+};
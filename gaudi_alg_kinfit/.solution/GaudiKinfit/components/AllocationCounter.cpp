@@ -0,0 +1,85 @@
+#include "GaudiKinfit/AllocationCounter.h"
+
+#include <cstddef>
+
+// The glibc implementations to which we forward. Using these instead of
+// looking up the next malloc via dlsym avoids having to deal with dlsym
+// allocating memory itself
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+// initial-exec makes sure that accessing the counters never allocates
+__attribute__((tls_model("initial-exec"))) thread_local KinfitAllocationCounts counts{0, 0, 0};
+
+inline void countAlloc(std::size_t size) {
+  ++counts.nAllocs;
+  counts.bytes += size;
+}
+} // namespace
+
+extern "C" {
+
+KinfitAllocationCounts kinfit_allocation_counts() { return counts; }
+
+void* malloc(std::size_t size) {
+  countAlloc(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) {
+  countAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+
+// Depending on the arguments realloc allocates, frees or does both
+void* realloc(void* ptr, std::size_t size) {
+  if (!ptr) {
+    countAlloc(size);
+    return __libc_realloc(ptr, size);
+  }
+  if (size == 0) {
+    ++counts.nFrees;
+    return __libc_realloc(ptr, size);
+  }
+  auto* newPtr = __libc_realloc(ptr, size);
+  // On failure the original block is left untouched
+  if (newPtr) {
+    ++counts.nFrees;
+    countAlloc(size);
+  }
+  return newPtr;
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+  countAlloc(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) {
+  countAlloc(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) {
+  // Mimic the argument checks of glibc, as __libc_memalign does not do them
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) {
+    return 22; // EINVAL
+  }
+  countAlloc(size);
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : 12; // ENOMEM
+}
+
+void free(void* ptr) {
+  if (ptr) {
+    ++counts.nFrees;
+  }
+  __libc_free(ptr);
+}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <edm4hep/utils/kinematics.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <vector>
+
+namespace kinfit {
+
+/// The largest opening angle two particles with momenta p and at least pMin
+/// can have, if their invariant mass is at most maxMass. Follows from
+/// M^2 >= 2 * p1 * p2 * (1 - cos(alpha)), which is exact for massless
+/// particles and a lower bound otherwise
+inline double maxOpeningAngle(double maxMass, double p, double pMin) {
+  if (p <= 0 || pMin <= 0) {
+    return std::numbers::pi;
+  }
+  const auto cosAlpha = 1 - maxMass * maxMass / (2 * p * pMin);
+  return cosAlpha <= -1 ? std::numbers::pi : std::acos(cosAlpha);
+}
+
+/// Index of the directions of a set of particles on a (theta, phi) grid, to
+/// find all particles within a given angle of a particle without comparing it
+/// to all other particles. Built once per event, and can then be queried with
+/// different angles, e.g. an angle depending on the energy of the particle.
+class AngularIndex {
+public:
+  explicit AngularIndex(std::span<const edm4hep::LorentzVectorE> p4s, std::size_t nThetaBins = 16,
+                        std::size_t nPhiBins = 32)
+      : m_nThetaBins(std::max<std::size_t>(nThetaBins, 1)), m_nPhiBins(std::max<std::size_t>(nPhiBins, 1)),
+        m_thetaWidth(std::numbers::pi / m_nThetaBins), m_phiWidth(2 * std::numbers::pi / m_nPhiBins) {
+    m_particles.reserve(p4s.size());
+    auto cells = std::vector<std::size_t>{};
+    cells.reserve(p4s.size());
+    for (const auto& p4 : p4s) {
+      const auto p = p4.P();
+      auto& particle = m_particles.emplace_back();
+      particle.p = p;
+      if (p > 0) {
+        particle.dir = {p4.X() / p, p4.Y() / p, p4.Z() / p};
+      }
+      particle.theta = p4.Theta();
+      particle.phi = p4.Phi();
+      m_minMomentum = std::min(m_minMomentum, p);
+      cells.push_back(cell(thetaBin(particle.theta), phiBin(particle.phi)));
+    }
+
+    // Sort the particles by cell, keeping the particles in each cell in order
+    m_cellOffsets.assign(m_nThetaBins * m_nPhiBins + 1, 0);
+    for (const auto c : cells) {
+      ++m_cellOffsets[c + 1];
+    }
+    for (std::size_t c = 1; c < m_cellOffsets.size(); ++c) {
+      m_cellOffsets[c] += m_cellOffsets[c - 1];
+    }
+    m_sorted.resize(cells.size());
+    auto fill = std::vector<std::size_t>(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+      m_sorted[fill[cells[i]]++] = i;
+    }
+  }
+
+  std::size_t size() const { return m_particles.size(); }
+  /// The momentum of particle i
+  double momentum(std::size_t i) const { return m_particles[i].p; }
+  /// The smallest momentum of all particles
+  double minMomentum() const { return m_particles.empty() ? 0. : m_minMomentum; }
+
+  /// Call callback(j) for all particles j != i with an opening angle of at
+  /// most maxAngle to particle i. Only the cells that can contain such
+  /// particles are visited. Particles are visited in no particular order
+  template <typename Callback>
+  void forEachNeighbour(std::size_t i, double maxAngle, Callback&& callback) const {
+    if (maxAngle >= std::numbers::pi || m_particles[i].p <= 0) {
+      for (std::size_t j = 0; j < size(); ++j) {
+        if (j != i) {
+          callback(j);
+        }
+      }
+      return;
+    }
+
+    const auto& particle = m_particles[i];
+    // Small tolerance, such that rounding never removes a particle at the edge
+    const auto minCosAngle = std::cos(maxAngle) - 1e-9;
+    const auto visitCell = [&](std::size_t c) {
+      for (auto k = m_cellOffsets[c]; k < m_cellOffsets[c + 1]; ++k) {
+        const auto j = m_sorted[k];
+        if (j != i && dot(particle, m_particles[j]) >= minCosAngle) {
+          callback(j);
+        }
+      }
+    };
+
+    const auto thetaMin = particle.theta - maxAngle;
+    const auto thetaMax = particle.theta + maxAngle;
+    const auto firstThetaBin = thetaBin(std::max(thetaMin, 0.));
+    const auto lastThetaBin = thetaBin(std::min(thetaMax, std::numbers::pi));
+
+    // All phi values are allowed if the cone contains one of the poles,
+    // otherwise the cone spans |dphi| <= asin(sin(alpha) / sin(theta))
+    auto nPhi = m_nPhiBins;
+    auto firstPhiBin = std::size_t{0};
+    if (thetaMin > 0 && thetaMax < std::numbers::pi) {
+      const auto maxDeltaPhi = std::asin(std::min(1., std::sin(maxAngle) / std::sin(particle.theta)));
+      const auto first = static_cast<long>(std::floor((particle.phi - maxDeltaPhi + std::numbers::pi) / m_phiWidth));
+      const auto last = static_cast<long>(std::floor((particle.phi + maxDeltaPhi + std::numbers::pi) / m_phiWidth));
+      if (last - first + 1 < static_cast<long>(m_nPhiBins)) {
+        nPhi = last - first + 1;
+        const auto n = static_cast<long>(m_nPhiBins);
+        firstPhiBin = ((first % n) + n) % n;
+      }
+    }
+
+    for (auto t = firstThetaBin; t <= lastThetaBin; ++t) {
+      for (std::size_t k = 0; k < nPhi; ++k) {
+        visitCell(cell(t, (firstPhiBin + k) % m_nPhiBins));
+      }
+    }
+  }
+
+private:
+  struct Particle {
+    double p{};
+    double theta{};
+    double phi{};
+    std::array<double, 3> dir{0., 0., 1.};
+  };
+
+  static double dot(const Particle& a, const Particle& b) {
+    return a.dir[0] * b.dir[0] + a.dir[1] * b.dir[1] + a.dir[2] * b.dir[2];
+  }
+
+  std::size_t thetaBin(double theta) const {
+    return std::min(static_cast<std::size_t>(std::max(theta, 0.) / m_thetaWidth), m_nThetaBins - 1);
+  }
+  std::size_t phiBin(double phi) const {
+    return std::min(static_cast<std::size_t>(std::max(phi + std::numbers::pi, 0.) / m_phiWidth), m_nPhiBins - 1);
+  }
+  std::size_t cell(std::size_t thetaBin, std::size_t phiBin) const { return thetaBin * m_nPhiBins + phiBin; }
+
+  std::size_t m_nThetaBins;
+  std::size_t m_nPhiBins;
+  double m_thetaWidth;
+  double m_phiWidth;
+  std::vector<Particle> m_particles;
+  double m_minMomentum{std::numeric_limits<double>::max()};
+  /// The particles in cell c are m_sorted[m_cellOffsets[c]] to
+  /// m_sorted[m_cellOffsets[c + 1] - 1]
+  std::vector<std::size_t> m_cellOffsets;
+  std::vector<std::size_t> m_sorted;
+};
+
+} // namespace kinfit
@@ -0,0 +1,321 @@
+#include "AsyncOutputWriter.hpp"
+
+#include <GaudiKernel/ThreadLocalContext.h>
+
+#include <TROOT.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+/// Copy the objects of all inputs into new collections in the frame, keeping
+/// the relations between them. copyRelations(original, copy, findCopy) sets
+/// the relations of one copied object, where findCopy returns the copy of a
+/// related object if it is part of the inputs. Since the copies are owned by
+/// the frame, it can be written on another thread, independent of the lifetime
+/// of the event
+template <typename Collection, typename CopyRelations>
+void copyCollections(podio::Frame& frame, const std::vector<const Collection*>& inputs,
+                     const std::vector<std::string>& names, CopyRelations copyRelations) {
+  using Object = typename Collection::value_type;
+
+  auto outputs = std::vector<Collection>(inputs.size());
+  auto outputIndexByID = std::unordered_map<std::uint32_t, std::size_t>{};
+
+  for (std::size_t k = 0; k < inputs.size(); ++k) {
+    if (inputs[k]->isSubsetCollection()) {
+      continue;
+    }
+    outputIndexByID.emplace(inputs[k]->getID(), k);
+    for (const auto& object : *inputs[k]) {
+      outputs[k].push_back(object.clone(false));
+    }
+  }
+
+  const auto findCopy = [&](const Object& object) -> std::optional<Object> {
+    const auto id = object.getObjectID();
+    const auto it = outputIndexByID.find(id.collectionID);
+    if (it == outputIndexByID.end()) {
+      return std::nullopt;
+    }
+    return outputs[it->second][id.index];
+  };
+
+  for (std::size_t k = 0; k < inputs.size(); ++k) {
+    const auto& input = *inputs[k];
+    if (input.isSubsetCollection()) {
+      outputs[k].setSubsetCollection();
+      for (const auto& object : input) {
+        if (const auto copy = findCopy(object)) {
+          outputs[k].push_back(*copy);
+        }
+      }
+      continue;
+    }
+    for (std::size_t i = 0; i < input.size(); ++i) {
+      copyRelations(input[i], outputs[k][i], findCopy);
+    }
+  }
+
+  for (std::size_t k = 0; k < outputs.size(); ++k) {
+    frame.put(std::move(outputs[k]), names[k]);
+  }
+}
+
+podio::Frame copyToFrame(const std::vector<const edm4hep::ReconstructedParticleCollection*>& particles,
+                         const std::vector<std::string>& particleNames,
+                         const std::vector<const edm4hep::MCParticleCollection*>& mcParticles,
+                         const std::vector<std::string>& mcParticleNames) {
+  auto frame = podio::Frame{};
+  copyCollections(frame, particles, particleNames, [](const auto& particle, auto copy, const auto& findCopy) {
+    for (const auto& daughter : particle.getParticles()) {
+      if (const auto daughterCopy = findCopy(daughter)) {
+        copy.addToParticles(*daughterCopy);
+      }
+    }
+  });
+  copyCollections(frame, mcParticles, mcParticleNames, [](const auto& particle, auto copy, const auto& findCopy) {
+    for (const auto& parent : particle.getParents()) {
+      if (const auto parentCopy = findCopy(parent)) {
+        copy.addToParents(*parentCopy);
+      }
+    }
+    for (const auto& daughter : particle.getDaughters()) {
+      if (const auto daughterCopy = findCopy(daughter)) {
+        copy.addToDaughters(*daughterCopy);
+      }
+    }
+  });
+  return frame;
+}
+
+/// The name of the i-th output file, when the output is split into several
+std::string partFileName(const std::string& outputFile, std::size_t i) {
+  const auto path = std::filesystem::path(outputFile);
+  return (path.parent_path() / fmt::format("{}_{:04d}{}", path.stem().string(), i, path.extension().string()))
+      .string();
+}
+
+/// The checkpoint is a text file with the input position up to which all
+/// events have been written, the ranges [first, last + 1) of input positions
+/// after it that have been written as well, and the names of the complete
+/// output files:
+///   processed_events <n>
+///   written <first> <last + 1>
+///   ...
+///   output "<file name>"
+///   ...
+struct Checkpoint {
+  std::uint64_t processedEvents{0};
+  kinfit::FrameWriterThread::EventRanges writtenEvents;
+  std::vector<std::string> outputFiles;
+};
+
+/// Add the range [begin, end) to the ranges, merging it with overlapping or
+/// adjacent ones
+void addRange(kinfit::FrameWriterThread::EventRanges& ranges, std::uint64_t begin, std::uint64_t end) {
+  auto it = ranges.upper_bound(begin);
+  if (it != ranges.begin() && std::prev(it)->second >= begin) {
+    --it;
+    begin = it->first;
+  }
+  while (it != ranges.end() && it->first <= end) {
+    end = std::max(end, it->second);
+    it = ranges.erase(it);
+  }
+  ranges.emplace(begin, end);
+}
+
+bool contains(const kinfit::FrameWriterThread::EventRanges& ranges, std::uint64_t position) {
+  const auto it = ranges.upper_bound(position);
+  return it != ranges.begin() && std::prev(it)->second > position;
+}
+
+Checkpoint readCheckpoint(const std::string& filename) {
+  auto checkpoint = Checkpoint{};
+  auto file = std::ifstream(filename);
+  auto key = std::string{};
+  while (file >> key) {
+    if (key == "processed_events") {
+      file >> checkpoint.processedEvents;
+    } else if (key == "written") {
+      auto begin = std::uint64_t{};
+      auto end = std::uint64_t{};
+      file >> begin >> end;
+      addRange(checkpoint.writtenEvents, begin, end);
+    } else if (key == "output") {
+      file >> std::quoted(checkpoint.outputFiles.emplace_back());
+    } else {
+      throw std::runtime_error("Invalid entry in checkpoint file: " + key);
+    }
+  }
+  if (file.fail() && !file.eof()) {
+    throw std::runtime_error("Could not parse checkpoint file " + filename);
+  }
+  return checkpoint;
+}
+
+/// Write via a temporary file, such that there is always a complete checkpoint
+/// even if the job is killed while writing it
+void writeCheckpointFile(const std::string& filename, const Checkpoint& checkpoint) {
+  const auto tmpFilename = filename + ".tmp";
+  {
+    auto file = std::ofstream(tmpFilename);
+    file << "processed_events " << checkpoint.processedEvents << '\n';
+    for (const auto& [begin, end] : checkpoint.writtenEvents) {
+      file << "written " << begin << ' ' << end << '\n';
+    }
+    for (const auto& outputFile : checkpoint.outputFiles) {
+      file << "output " << std::quoted(outputFile) << '\n';
+    }
+    file.flush();
+    if (!file) {
+      throw std::runtime_error("Could not write checkpoint file " + tmpFilename);
+    }
+  }
+  std::filesystem::rename(tmpFilename, filename);
+}
+} // namespace
+
+AsyncOutputWriter::AsyncOutputWriter(const std::string& name, ISvcLocator* svcLoc)
+    : Consumer(name, svcLoc,
+               {KeyValues("InputCollections", {"GammaGammaCandidates"}),
+                KeyValues("MCParticleCollections", {"MCParticles"})}) {}
+
+StatusCode AsyncOutputWriter::initialize() {
+  auto sc = Consumer::initialize();
+  if (sc.isFailure()) {
+    return sc;
+  }
+
+  m_collectionNames = inputLocations("InputCollections");
+  m_mcCollectionNames = inputLocations("MCParticleCollections");
+
+  // ROOT is used from the writer thread and the input thread concurrently
+  ROOT::EnableThreadSafety();
+  try {
+    const auto onMessage = [this](const std::string& message) { warning() << message << endmsg; };
+    if (m_checkpointFile.value().empty()) {
+      m_writer = std::make_unique<kinfit::FrameWriterThread>(m_outputFile.value(), m_maxQueueSize.value(),
+                                                             m_reorder.value(), onMessage);
+      return StatusCode::SUCCESS;
+    }
+
+    // Checkpoints are only consistent if the events are written in order
+    if (!m_reorder.value() || m_checkpointInterval.value() == 0) {
+      error() << "Checkpointing requires ReorderEvents and a CheckpointInterval > 0" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (std::filesystem::exists(m_checkpointFile.value())) {
+      auto checkpoint = readCheckpoint(m_checkpointFile.value());
+      m_resumedEvents = checkpoint.processedEvents;
+      m_writtenEvents = std::move(checkpoint.writtenEvents);
+      m_completedFiles = std::move(checkpoint.outputFiles);
+      info() << fmt::format("Resuming from checkpoint {}: the first {} events have already been written to {} files",
+                            m_checkpointFile.value(), m_resumedEvents, m_completedFiles.size())
+             << endmsg;
+      auto nWritten = std::uint64_t{0};
+      for (const auto& [begin, end] : m_writtenEvents) {
+        nWritten += end - begin;
+      }
+      if (nWritten > 0) {
+        info() << fmt::format("{} events after that have been written already as well and are dropped", nWritten)
+               << endmsg;
+      }
+    }
+
+    // The event loop numbers the events of every job from 0, independent of
+    // IOSvc.FirstEventEntry, such that the input position of an event is
+    // m_resumedEvents + its event number
+    const auto firstFile = m_completedFiles.size();
+    m_writer = std::make_unique<kinfit::FrameWriterThread>(
+        [this, firstFile](std::size_t i) { return partFileName(m_outputFile.value(), firstFile + i); },
+        m_checkpointInterval.value(),
+        [this](const std::string& closedFile, std::uint64_t nCompleted,
+               const kinfit::FrameWriterThread::EventRanges& written) {
+          writeCheckpoint(closedFile, nCompleted, written);
+        },
+        m_maxQueueSize.value(), m_reorder.value(), onMessage, 0);
+  } catch (const std::exception& ex) {
+    error() << "Could not set up the output to " << m_outputFile.value() << ": " << ex.what() << endmsg;
+    return StatusCode::FAILURE;
+  }
+
+  return StatusCode::SUCCESS;
+}
+
+void AsyncOutputWriter::writeCheckpoint(const std::string& closedFile, std::uint64_t nCompletedEvents,
+                                        const kinfit::FrameWriterThread::EventRanges& writtenEvents) {
+  m_completedFiles.push_back(closedFile);
+  const auto processedEvents = m_resumedEvents + nCompletedEvents;
+  // The events written by a previous job have only been marked as written in
+  // this one if it got to them already
+  auto written = kinfit::FrameWriterThread::EventRanges{};
+  for (const auto& [begin, end] : m_writtenEvents) {
+    if (end > processedEvents) {
+      addRange(written, std::max(begin, processedEvents), end);
+    }
+  }
+  for (const auto& [begin, end] : writtenEvents) {
+    addRange(written, m_resumedEvents + begin, m_resumedEvents + end);
+  }
+  writeCheckpointFile(m_checkpointFile.value(), {processedEvents, std::move(written), m_completedFiles});
+}
+
+void AsyncOutputWriter::operator()(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs,
+                                   const std::vector<const edm4hep::MCParticleCollection*>& mcInputs) const {
+  const auto eventNumber = Gaudi::Hive::currentContext().evt();
+  // Written by the job that is resumed, after events that it had not written
+  if (contains(m_writtenEvents, m_resumedEvents + eventNumber)) {
+    m_writer->pushWritten(eventNumber);
+    return;
+  }
+  m_writer->push(eventNumber, copyToFrame(inputs, m_collectionNames, mcInputs, m_mcCollectionNames));
+}
+
+StatusCode AsyncOutputWriter::finalize() {
+  if (m_writer) {
+    try {
+      const auto stats = m_writer->finish();
+      info() << fmt::format("Wrote {} events to {} file(s) for {}", stats.nFrames, stats.nFiles, m_outputFile.value())
+             << endmsg;
+      info() << fmt::format("Queue depth: mean {:.2f}, max {} (limit {}), max events held back for reordering: {}",
+                            stats.meanQueueDepth, stats.maxQueueDepth, m_maxQueueSize.value(),
+                            stats.maxReorderBacklog)
+             << endmsg;
+      if (stats.nSkippedEvents > 0 || stats.nLateEvents > 0) {
+        warning() << fmt::format("Gave up waiting for {} missing event(s), {} of them have been written out of order",
+                                 stats.nSkippedEvents, stats.nLateEvents)
+                  << endmsg;
+      }
+      info() << fmt::format("Processing stalled on a full queue for {:.3f} s, writer busy for {:.3f} s and idle for "
+                            "{:.3f} s",
+                            stats.stallSeconds, stats.writeSeconds, stats.idleSeconds)
+             << endmsg;
+      if (!m_checkpointFile.value().empty()) {
+        info() << fmt::format("Closing files and writing checkpoints took {:.3f} s in total ({:.3f} ms per "
+                              "checkpoint)",
+                              stats.closeSeconds, stats.nFiles > 0 ? 1e3 * stats.closeSeconds / stats.nFiles : 0.)
+               << endmsg;
+      }
+    } catch (const std::exception& ex) {
+      error() << "Writing " << m_outputFile.value() << " failed: " << ex.what() << endmsg;
+      return StatusCode::FAILURE;
+    }
+    m_writer.reset();
+  }
+
+  return Consumer::finalize();
+}
+
+DECLARE_COMPONENT(AsyncOutputWriter)
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "FrameWriterThread.hpp"
+
+#include <k4FWCore/Consumer.h>
+
+#include <edm4hep/MCParticleCollection.h>
+#include <edm4hep/ReconstructedParticleCollection.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Write collections to an output file asynchronously. In contrast to setting
+/// IOSvc.Output, where an event is written at the end of its processing on the
+/// same thread, events are only copied into a podio::Frame here and handed to a
+/// dedicated writer thread via a bounded queue (see kinfit::FrameWriterThread).
+/// Compressing and writing an event hence overlaps with processing the next
+/// events.
+///
+/// ReconstructedParticle collections (InputCollections) and MCParticle
+/// collections (MCParticleCollections) are supported. Relations between the
+/// written particles are kept (including the parents and daughters of the
+/// MCParticles), relations to particles in collections that are not written
+/// are dropped. Has to run after all algorithms producing its inputs, i.e. at
+/// the end of TopAlg.
+///
+/// With a CheckpointFile, the output is split into files of CheckpointInterval
+/// events each (named <OutputFile stem>_<number>.root). Every time one of these
+/// has been closed, the input position up to which all events have been
+/// written and the list of complete files are stored in the checkpoint file.
+/// The position is the entry in the input of the first event that the writer
+/// gave up waiting for (see kinfit::FrameWriterThread). The positions of the
+/// later events that have been written nevertheless are stored as well. If the
+/// checkpoint file exists at the start of a job, the previous state is picked
+/// up and the numbering of the output files continues, so a job that has been
+/// interrupted can be restarted from that position (by setting
+/// IOSvc.FirstEventEntry to the processed_events from the checkpoint). The
+/// events at positions that have been written already are dropped then.
+struct AsyncOutputWriter final
+    : public k4FWCore::Consumer<void(const std::vector<const edm4hep::ReconstructedParticleCollection*>&,
+                                     const std::vector<const edm4hep::MCParticleCollection*>&)> {
+
+  AsyncOutputWriter(const std::string& name, ISvcLocator* svcLoc);
+
+  StatusCode initialize() override;
+
+  void operator()(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs,
+                  const std::vector<const edm4hep::MCParticleCollection*>& mcInputs) const override;
+
+  StatusCode finalize() override;
+
+private:
+  Gaudi::Property<std::string> m_outputFile{this, "OutputFile", "async_output.root", "The output file"};
+
+  Gaudi::Property<std::size_t> m_maxQueueSize{
+      this, "MaxQueueSize", 8,
+      "Maximum number of events waiting to be written, including those held back for reordering. Processing blocks "
+      "if the writer falls behind further. Has to be larger than the number of events processed concurrently"};
+
+  Gaudi::Property<bool> m_reorder{
+      this, "ReorderEvents", true,
+      "Write events in input order, independent of the order in which they finish processing"};
+
+  Gaudi::Property<std::string> m_checkpointFile{
+      this, "CheckpointFile", "", "File to store the progress in, for resuming the job. No checkpoints if empty"};
+
+  Gaudi::Property<std::uint64_t> m_checkpointInterval{
+      this, "CheckpointInterval", 1000,
+      "Number of events between two checkpoints, i.e. the number of events per output file"};
+
+  /// Called from the writer thread every time an output file has been closed,
+  /// with the number of consecutive events of this job that have been written
+  /// and the events of this job after them that have been written as well
+  void writeCheckpoint(const std::string& closedFile, std::uint64_t nCompletedEvents,
+                       const kinfit::FrameWriterThread::EventRanges& writtenEvents);
+
+  std::vector<std::string> m_collectionNames;
+  std::vector<std::string> m_mcCollectionNames;
+  std::unique_ptr<kinfit::FrameWriterThread> m_writer;
+  /// The state of the checkpoint. m_resumedEvents is the input position at
+  /// which this job started and m_writtenEvents the input positions after it
+  /// that have been written before. Both are only read after initialize,
+  /// m_completedFiles is only accessed by the writer thread after initialize
+  std::uint64_t m_resumedEvents{0};
+  kinfit::FrameWriterThread::EventRanges m_writtenEvents;
+  std::vector<std::string> m_completedFiles;
+};
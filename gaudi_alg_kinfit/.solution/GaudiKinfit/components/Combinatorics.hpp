@@ -0,0 +1,173 @@
+#pragma once
+
+#include <edm4hep/ReconstructedParticle.h>
+#include <edm4hep/ReconstructedParticleCollection.h>
+#include <edm4hep/utils/kinematics.h>
+
+#include <podio/ObjectID.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace kinfit {
+
+/// The particles of one input collection, prepared for building combinations.
+///
+/// Every particle has a set of leaves, the final state particles it has been
+/// built from. For particles without daughters this is the particle itself,
+/// for composite particles (e.g. pi0 candidates) these are its daughters. The
+/// leaves are used to make sure that no final state particle is used twice
+/// in a combination, and they are the objects that enter the kinematic fit.
+struct CombinatoricsInput {
+  explicit CombinatoricsInput(const edm4hep::ReconstructedParticleCollection& particles) : collection(&particles) {
+    p4s.reserve(particles.size());
+    charges.reserve(particles.size());
+    leafOffsets.reserve(particles.size() + 1);
+    leafOffsets.push_back(0);
+    for (const auto& particle : particles) {
+      p4s.emplace_back(edm4hep::utils::p4(particle, edm4hep::utils::UseEnergy));
+      charges.push_back(particle.getCharge());
+      const auto daughters = particle.getParticles();
+      if (daughters.size() == 0) {
+        leaves.push_back(particle);
+      } else {
+        leaves.insert(leaves.end(), daughters.begin(), daughters.end());
+      }
+      leafOffsets.push_back(leaves.size());
+      minMass = std::min(minMass, std::max(0.0, p4s.back().M()));
+    }
+    leafIDs.reserve(leaves.size());
+    for (const auto& leaf : leaves) {
+      leafIDs.push_back(leaf.getObjectID());
+    }
+  }
+
+  std::size_t size() const { return p4s.size(); }
+
+  std::span<const edm4hep::ReconstructedParticle> leavesOf(std::size_t i) const {
+    return std::span(leaves).subspan(leafOffsets[i], leafOffsets[i + 1] - leafOffsets[i]);
+  }
+  std::span<const podio::ObjectID> leafIDsOf(std::size_t i) const {
+    return std::span(leafIDs).subspan(leafOffsets[i], leafOffsets[i + 1] - leafOffsets[i]);
+  }
+
+  const edm4hep::ReconstructedParticleCollection* collection;
+  std::vector<edm4hep::LorentzVectorE> p4s;
+  std::vector<float> charges;
+  /// The leaves of particle i are at [leafOffsets[i], leafOffsets[i + 1])
+  std::vector<std::size_t> leafOffsets;
+  std::vector<edm4hep::ReconstructedParticle> leaves;
+  std::vector<podio::ObjectID> leafIDs;
+  /// The smallest (non-negative) mass of all particles
+  double minMass{std::numeric_limits<double>::max()};
+};
+
+/// Builds all combinations of particles for a decay into a fixed list of
+/// daughters, where each daughter is taken from one of several inputs.
+///
+/// Daughters that are taken from the same input are only combined in
+/// ascending order, so that every combination is built only once, and
+/// combinations that use a final state particle more than once are skipped.
+/// Since the invariant mass of a system is always larger than the mass of any
+/// subsystem plus the masses of the remaining particles, partial combinations
+/// are discarded as soon as they exceed the upper edge of the mass window.
+class CombinationBuilder {
+public:
+  /// daughterInputs contains the index of the input for every daughter
+  CombinationBuilder(std::vector<std::size_t> daughterInputs, double mass, double maxDeltaM, int totalCharge)
+      : m_daughterInputs(std::move(daughterInputs)), m_mass(mass), m_maxDeltaM(maxDeltaM), m_totalCharge(totalCharge),
+        m_previousSameInput(m_daughterInputs.size(), -1) {
+    if (m_daughterInputs.empty()) {
+      throw std::invalid_argument("A decay needs at least one daughter");
+    }
+    for (std::size_t d = 0; d < m_daughterInputs.size(); ++d) {
+      for (std::size_t prev = 0; prev < d; ++prev) {
+        if (m_daughterInputs[prev] == m_daughterInputs[d]) {
+          m_previousSameInput[d] = static_cast<int>(prev);
+        }
+      }
+    }
+  }
+
+  std::size_t nDaughters() const { return m_daughterInputs.size(); }
+  std::size_t nInputs() const { return *std::max_element(m_daughterInputs.begin(), m_daughterInputs.end()) + 1; }
+  /// The index of the input that daughter d is taken from
+  std::size_t daughterInput(std::size_t d) const { return m_daughterInputs[d]; }
+
+  /// Call callback(indices, p4) for every combination in the mass window and
+  /// with the required total charge. indices[d] is the index of daughter d in
+  /// its input and p4 is the combined four momentum
+  template <typename Callback>
+  void forEach(std::span<const CombinatoricsInput> inputs, Callback&& callback) const {
+    if (inputs.size() < nInputs()) {
+      throw std::invalid_argument("Not enough inputs for the configured daughters");
+    }
+
+    // The minimal mass that the daughters after d add to a combination
+    auto remainingMinMass = std::vector<double>(nDaughters(), 0.0);
+    for (std::size_t d = nDaughters() - 1; d > 0; --d) {
+      remainingMinMass[d - 1] = remainingMinMass[d] + inputs[m_daughterInputs[d]].minMass;
+    }
+
+    auto state = State{inputs, remainingMinMass, std::vector<std::size_t>(nDaughters()), {}};
+    recurse(0, {}, 0.f, state, callback);
+  }
+
+private:
+  struct State {
+    std::span<const CombinatoricsInput> inputs;
+    const std::vector<double>& remainingMinMass;
+    std::vector<std::size_t> indices;
+    std::vector<podio::ObjectID> usedLeaves;
+  };
+
+  template <typename Callback>
+  void recurse(std::size_t depth, const edm4hep::LorentzVectorE& partialP4, float partialCharge, State& state,
+               Callback& callback) const {
+    const auto& input = state.inputs[m_daughterInputs[depth]];
+    const auto prev = m_previousSameInput[depth];
+    const auto first = prev < 0 ? 0 : state.indices[prev] + 1;
+    const auto maxMass = m_mass + m_maxDeltaM - state.remainingMinMass[depth];
+
+    for (std::size_t i = first; i < input.size(); ++i) {
+      const auto p4 = partialP4 + input.p4s[i];
+      if (p4.M() > maxMass) {
+        continue;
+      }
+      const auto leafIDs = input.leafIDsOf(i);
+      if (std::any_of(leafIDs.begin(), leafIDs.end(), [&state](const auto& id) {
+            return std::find(state.usedLeaves.begin(), state.usedLeaves.end(), id) != state.usedLeaves.end();
+          })) {
+        continue;
+      }
+
+      state.indices[depth] = i;
+      const auto charge = partialCharge + input.charges[i];
+      if (depth + 1 == nDaughters()) {
+        if (std::abs(p4.M() - m_mass) <= m_maxDeltaM && std::lround(charge) == m_totalCharge) {
+          callback(std::span<const std::size_t>(state.indices), p4);
+        }
+        continue;
+      }
+
+      state.usedLeaves.insert(state.usedLeaves.end(), leafIDs.begin(), leafIDs.end());
+      recurse(depth + 1, p4, charge, state, callback);
+      state.usedLeaves.resize(state.usedLeaves.size() - leafIDs.size());
+    }
+  }
+
+  std::vector<std::size_t> m_daughterInputs;
+  double m_mass;
+  double m_maxDeltaM;
+  int m_totalCharge;
+  /// The index of the last daughter before d with the same input, or -1
+  std::vector<int> m_previousSameInput;
+};
+
+} // namespace kinfit
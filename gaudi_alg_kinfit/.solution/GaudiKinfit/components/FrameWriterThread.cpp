@@ -0,0 +1,279 @@
+#include "FrameWriterThread.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace kinfit {
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+} // namespace
+
+FrameWriterThread::FrameWriterThread(const std::string& filename, std::size_t maxQueueSize, bool reorder,
+                                     MessageFunc onMessage)
+    : FrameWriterThread([filename](std::size_t) { return filename; }, 0, {}, maxQueueSize, reorder,
+                        std::move(onMessage)) {}
+
+FrameWriterThread::FrameWriterThread(FileNameFunc fileName, std::uint64_t framesPerFile, FileClosedFunc onFileClosed,
+                                     std::size_t maxQueueSize, bool reorder, MessageFunc onMessage,
+                                     std::optional<std::uint64_t> firstEvent)
+    : m_fileName(std::move(fileName)), m_framesPerFile(framesPerFile), m_onFileClosed(std::move(onFileClosed)),
+      m_onMessage(std::move(onMessage)), m_currentFile(m_fileName(0)),
+      m_maxQueueSize(std::max<std::size_t>(maxQueueSize, 1)), m_reorder(reorder), m_nextEvent(firstEvent),
+      m_firstEvent(firstEvent.value_or(0)) {
+  // Open the first file here, such that problems are reported immediately
+  m_writer.emplace(podio::makeWriter(m_currentFile));
+  m_thread = std::thread(&FrameWriterThread::run, this);
+}
+
+FrameWriterThread::~FrameWriterThread() {
+  if (m_thread.joinable()) {
+    try {
+      finish();
+    } catch (...) {
+      // Nothing sensible left to do with errors at this point
+    }
+  }
+}
+
+void FrameWriterThread::push(std::uint64_t eventNumber, podio::Frame frame) {
+  enqueue(eventNumber, std::move(frame));
+}
+
+void FrameWriterThread::pushWritten(std::uint64_t eventNumber) {
+  if (m_reorder) {
+    enqueue(eventNumber, std::nullopt);
+  }
+}
+
+void FrameWriterThread::enqueue(std::uint64_t eventNumber, std::optional<podio::Frame> frame) {
+  auto lock = std::unique_lock(m_mutex);
+  if (m_queue.size() + m_backlogSize >= m_maxQueueSize && !m_error) {
+    const auto stallStart = Clock::now();
+    m_notFull.wait(lock, [this] { return m_queue.size() + m_backlogSize < m_maxQueueSize || m_error; });
+    m_stats.stallSeconds += secondsSince(stallStart);
+  }
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+
+  m_queue.emplace_back(eventNumber, std::move(frame));
+  m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_queue.size());
+  m_sumQueueDepth += m_queue.size();
+  ++m_nPushed;
+  lock.unlock();
+  m_notEmpty.notify_one();
+}
+
+FrameWriterStatistics FrameWriterThread::finish() {
+  {
+    auto lock = std::lock_guard(m_mutex);
+    m_finishing = true;
+  }
+  m_notEmpty.notify_one();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+
+  m_stats.meanQueueDepth = m_nPushed > 0 ? static_cast<double>(m_sumQueueDepth) / m_nPushed : 0.;
+  return m_stats;
+}
+
+void FrameWriterThread::run() {
+  try {
+    while (true) {
+      auto lock = std::unique_lock(m_mutex);
+      const auto idleStart = Clock::now();
+      m_notEmpty.wait(lock, [this] { return !m_queue.empty() || m_finishing; });
+      m_stats.idleSeconds += secondsSince(idleStart);
+      if (m_queue.empty()) {
+        break;
+      }
+      auto [eventNumber, frame] = std::move(m_queue.front());
+      m_queue.pop_front();
+      if (m_reorder) {
+        // Still occupies its place in the queue until it has been written
+        ++m_backlogSize;
+        lock.unlock();
+        reorder(eventNumber, std::move(frame));
+        continue;
+      }
+      lock.unlock();
+      m_notFull.notify_one();
+      write(frame);
+    }
+
+    // Only left over if some events never arrived (e.g. because processing
+    // them failed). Keep the remaining ones in order nevertheless
+    while (!m_backlog.empty()) {
+      skipToBacklog();
+      writeBacklog();
+    }
+    if (m_writer) {
+      closeFile();
+    }
+  } catch (...) {
+    auto lock = std::lock_guard(m_mutex);
+    m_error = std::current_exception();
+    m_queue.clear();
+    m_notFull.notify_all();
+  }
+}
+
+void FrameWriterThread::reorder(std::uint64_t eventNumber, std::optional<podio::Frame> frame) {
+  if (!m_nextEvent) {
+    m_nextEvent = eventNumber;
+    m_firstEvent = eventNumber;
+  }
+  if (eventNumber < *m_nextEvent) {
+    // Split the missing range this event is in, if any
+    if (auto it = m_missing.upper_bound(eventNumber); it != m_missing.begin() && (--it)->second > eventNumber) {
+      const auto [begin, end] = *it;
+      m_missing.erase(it);
+      if (begin < eventNumber) {
+        m_missing.emplace(begin, eventNumber);
+      }
+      if (eventNumber + 1 < end) {
+        m_missing.emplace(eventNumber + 1, end);
+      }
+    }
+    if (frame) {
+      ++m_stats.nLateEvents;
+      message(
+          fmt::format("Event {} arrived after the writer has moved past it, writing it out of order", eventNumber));
+      write(frame);
+    }
+    releaseBacklog(1);
+    return;
+  }
+
+  if (const auto [it, inserted] = m_backlog.try_emplace(eventNumber, std::move(frame)); !inserted) {
+    if (frame) {
+      message(fmt::format("Event {} has been pushed more than once, writing it out of order", eventNumber));
+    }
+    write(frame);
+    releaseBacklog(1);
+    return;
+  }
+  m_stats.maxReorderBacklog = std::max(m_stats.maxReorderBacklog, m_backlog.size());
+  // Holding back more frames would block the producers, possibly including
+  // the one processing the next event
+  if (m_backlog.size() >= m_maxQueueSize) {
+    skipToBacklog();
+  }
+  writeBacklog();
+}
+
+void FrameWriterThread::skipToBacklog() {
+  const auto first = m_backlog.begin()->first;
+  if (first == *m_nextEvent) {
+    return;
+  }
+  const auto missing = first - *m_nextEvent == 1 ? fmt::format("Event {} is", *m_nextEvent)
+                                                  : fmt::format("Events {} to {} are", *m_nextEvent, first - 1);
+  message(fmt::format("{} missing, continuing with event {} without waiting any longer", missing, first));
+  m_stats.nSkippedEvents += first - *m_nextEvent;
+  m_missing.emplace(*m_nextEvent, first);
+  m_nextEvent = first;
+}
+
+void FrameWriterThread::writeBacklog() {
+  std::size_t nWritten = 0;
+  while (!m_backlog.empty() && m_backlog.begin()->first == *m_nextEvent) {
+    auto node = m_backlog.extract(m_backlog.begin());
+    ++*m_nextEvent;
+    write(node.mapped());
+    ++nWritten;
+  }
+  releaseBacklog(nWritten);
+}
+
+void FrameWriterThread::releaseBacklog(std::size_t nFrames) {
+  if (nFrames == 0) {
+    return;
+  }
+  {
+    auto lock = std::lock_guard(m_mutex);
+    m_backlogSize -= nFrames;
+  }
+  m_notFull.notify_all();
+}
+
+std::uint64_t FrameWriterThread::completedEvents() const {
+  if (!m_reorder) {
+    return m_stats.nFrames;
+  }
+  if (!m_nextEvent) {
+    return 0;
+  }
+  return (m_missing.empty() ? *m_nextEvent : m_missing.begin()->first) - m_firstEvent;
+}
+
+FrameWriterThread::EventRanges FrameWriterThread::writtenAfterCompleted() const {
+  auto written = EventRanges{};
+  if (!m_reorder || m_missing.empty()) {
+    return written;
+  }
+  // Everything between the missing ranges has been written
+  auto begin = m_missing.begin()->second;
+  for (auto it = std::next(m_missing.begin()); it != m_missing.end(); ++it) {
+    if (begin < it->first) {
+      written.emplace(begin, it->first);
+    }
+    begin = it->second;
+  }
+  if (begin < *m_nextEvent) {
+    written.emplace(begin, *m_nextEvent);
+  }
+  return written;
+}
+
+void FrameWriterThread::write(std::optional<podio::Frame>& frame) {
+  if (!frame) {
+    return;
+  }
+  const auto writeStart = Clock::now();
+  if (!m_writer) {
+    m_currentFile = m_fileName(m_stats.nFiles);
+    m_writer.emplace(podio::makeWriter(m_currentFile));
+  }
+  m_writer->writeEvent(*frame);
+  m_stats.writeSeconds += secondsSince(writeStart);
+  ++m_stats.nFrames;
+
+  // The next file is only opened with the next frame, to not leave an empty
+  // file behind after the last one
+  if (m_framesPerFile > 0 && ++m_framesInFile == m_framesPerFile) {
+    closeFile();
+  }
+}
+
+void FrameWriterThread::closeFile() {
+  const auto closeStart = Clock::now();
+  m_writer->finish();
+  m_writer.reset();
+  m_framesInFile = 0;
+  ++m_stats.nFiles;
+  if (m_onFileClosed) {
+    m_onFileClosed(m_currentFile, completedEvents(), writtenAfterCompleted());
+  }
+  m_stats.closeSeconds += secondsSince(closeStart);
+}
+
+void FrameWriterThread::message(const std::string& msg) const {
+  if (m_onMessage) {
+    m_onMessage(msg);
+  }
+}
+
+} // namespace kinfit
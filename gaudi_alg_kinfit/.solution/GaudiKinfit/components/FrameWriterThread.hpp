@@ -0,0 +1,171 @@
+#pragma once
+
+#include <podio/Frame.h>
+#include <podio/Writer.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace kinfit {
+
+struct FrameWriterStatistics {
+  std::uint64_t nFrames{};
+  /// Queue depth seen by the producers when pushing a frame (including it)
+  std::size_t maxQueueDepth{};
+  double meanQueueDepth{};
+  /// Largest number of frames held back to restore the input order
+  std::size_t maxReorderBacklog{};
+  /// Number of missing events that have been given up on, because too many
+  /// following events had to be held back
+  std::uint64_t nSkippedEvents{};
+  /// Number of frames that arrived after the writer had skipped past them and
+  /// that have hence been written out of order
+  std::uint64_t nLateEvents{};
+  /// Time the producers were blocked, because the queue was full
+  double stallSeconds{};
+  /// Time the writer thread spent waiting for frames
+  double idleSeconds{};
+  /// Time the writer thread spent writing (i.e. serialising and compressing)
+  double writeSeconds{};
+  /// Number of output files that have been closed
+  std::uint64_t nFiles{};
+  /// Time the writer thread spent closing files (including onFileClosed)
+  double closeSeconds{};
+};
+
+/// Writes podio::Frames to a file from a dedicated thread, such that the
+/// (expensive) serialisation and compression of an event overlaps with the
+/// processing of the following events.
+///
+/// Frames are passed via a bounded queue, push blocks if the writer thread
+/// falls behind by more than maxQueueSize frames. If reorder is set, frames
+/// are written in the order of their event numbers (starting from firstEvent,
+/// or the one of the first pushed frame if that is not known) rather than in
+/// the order in which they have been pushed, which makes the output of
+/// multi-threaded jobs reproducible.
+///
+/// The frames held back for reordering count towards maxQueueSize. If they
+/// alone fill it, the writer gives up on the missing events before them and
+/// continues with the next event it has, rather than blocking the producers
+/// indefinitely. Frames of these events that arrive later are written out of
+/// order. Both are reported via onMessage. To avoid this, maxQueueSize has to
+/// be larger than the number of events that are processed concurrently.
+///
+/// The output can be split into several files with a fixed number of events
+/// each. Every file is complete and readable as soon as it has been closed,
+/// which allows to checkpoint long running jobs. Events that a previous job
+/// has written already are passed via pushWritten, such that they take their
+/// place in the order without being written again.
+class FrameWriterThread {
+public:
+  /// Ranges [first, last + 1) of event numbers
+  using EventRanges = std::map<std::uint64_t, std::uint64_t>;
+  /// Returns the name of the i-th output file
+  using FileNameFunc = std::function<std::string(std::size_t)>;
+  /// Called from the writer thread after a file has been closed, with its name,
+  /// the number of consecutive events, starting from the first one, that have
+  /// all been written so far, and the ranges of events after these that have
+  /// been written as well. Events that are missing are not counted past, even
+  /// if the events after them have been written. Without reordering this is
+  /// simply the number of frames written, and there are no further ranges
+  using FileClosedFunc = std::function<void(const std::string&, std::uint64_t, const EventRanges&)>;
+  /// Called from the writer thread with a warning about missing or late
+  /// events
+  using MessageFunc = std::function<void(const std::string&)>;
+
+  FrameWriterThread(const std::string& filename, std::size_t maxQueueSize, bool reorder, MessageFunc onMessage = {});
+
+  /// Start a new file every framesPerFile frames (if not 0). The first event
+  /// should be passed when checkpointing with onFileClosed, otherwise an event
+  /// that arrives after a later first frame is not part of the consecutive
+  /// events
+  FrameWriterThread(FileNameFunc fileName, std::uint64_t framesPerFile, FileClosedFunc onFileClosed,
+                    std::size_t maxQueueSize, bool reorder, MessageFunc onMessage = {},
+                    std::optional<std::uint64_t> firstEvent = std::nullopt);
+  ~FrameWriterThread();
+
+  FrameWriterThread(const FrameWriterThread&) = delete;
+  FrameWriterThread& operator=(const FrameWriterThread&) = delete;
+
+  /// Queue a frame for writing. Rethrows any exception that occurred in the
+  /// writer thread
+  void push(std::uint64_t eventNumber, podio::Frame frame);
+
+  /// Mark an event as written without writing anything, because it has been
+  /// written before, e.g. by a job that is resumed now. Only has an effect
+  /// when reordering
+  void pushWritten(std::uint64_t eventNumber);
+
+  /// Write all queued frames, stop the writer thread and close the file.
+  /// Rethrows any exception that occurred in the writer thread
+  FrameWriterStatistics finish();
+
+private:
+  void run();
+  /// Add a frame to the reorder backlog and write all frames that are next in
+  /// order
+  void reorder(std::uint64_t eventNumber, std::optional<podio::Frame> frame);
+  /// Give up on all missing events before the first frame in the backlog
+  void skipToBacklog();
+  /// Write the frames at the front of the backlog that are next in order
+  void writeBacklog();
+  /// Remove written frames from the reorder backlog count of the producers
+  void releaseBacklog(std::size_t nFrames);
+  /// The number of consecutive events that have been written, see
+  /// FileClosedFunc
+  std::uint64_t completedEvents() const;
+  /// The ranges of events after the consecutive ones that have been written
+  EventRanges writtenAfterCompleted() const;
+  /// Queue a frame, or only the event number (nullopt) for pushWritten
+  void enqueue(std::uint64_t eventNumber, std::optional<podio::Frame> frame);
+  /// Write a frame, nothing happens for the events from pushWritten
+  void write(std::optional<podio::Frame>& frame);
+  void closeFile();
+  void message(const std::string& msg) const;
+
+  FileNameFunc m_fileName;
+  std::uint64_t m_framesPerFile;
+  FileClosedFunc m_onFileClosed;
+  MessageFunc m_onMessage;
+  /// Only accessed by the writer thread after construction
+  std::optional<podio::Writer> m_writer;
+  std::string m_currentFile;
+  std::uint64_t m_framesInFile{0};
+  std::size_t m_maxQueueSize;
+  bool m_reorder;
+
+  std::mutex m_mutex;
+  std::condition_variable m_notFull;
+  std::condition_variable m_notEmpty;
+  std::deque<std::pair<std::uint64_t, std::optional<podio::Frame>>> m_queue;
+  bool m_finishing{false};
+  std::exception_ptr m_error;
+  /// Number of frames taken from the queue but not yet written when
+  /// reordering, such that they count towards the queue size for push
+  std::size_t m_backlogSize{0};
+  /// Only accessed by the writer thread
+  std::map<std::uint64_t, std::optional<podio::Frame>> m_backlog;
+  /// Set with the first frame, unless the first event is known from the start
+  std::optional<std::uint64_t> m_nextEvent;
+  std::uint64_t m_firstEvent;
+  /// The events that have been skipped and have not arrived since
+  EventRanges m_missing;
+
+  FrameWriterStatistics m_stats;
+  std::uint64_t m_nPushed{};
+  std::uint64_t m_sumQueueDepth{};
+
+  std::thread m_thread;
+};
+
+} // namespace kinfit
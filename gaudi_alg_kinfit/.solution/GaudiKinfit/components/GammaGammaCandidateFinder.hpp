@@ -1,50 +1,73 @@
 #pragma once
 
-#include <BaseFitter.h>
+#include "ResonanceFinder.hpp"
+
+#include "GaudiKinfit/Histograms.h"
+#include "GaudiKinfit/Pi0Binning.h"
 
 #include <k4FWCore/Transformer.h>
 
 #include <edm4hep/ReconstructedParticleCollection.h>
-#include <edm4hep/utils/kinematics.h>
 
+#include <memory>
 #include <optional>
-#include <vector>
+#include <string>
+#include <tuple>
 
 struct GammaGammaCandidateFinder final : public k4FWCore::Transformer<edm4hep::ReconstructedParticleCollection(
                                              const edm4hep::ReconstructedParticleCollection&)> {
 
   GammaGammaCandidateFinder(const std::string& name, ISvcLocator* svcLoc);
 
+  StatusCode initialize() override;
+
   edm4hep::ReconstructedParticleCollection
   operator()(const edm4hep::ReconstructedParticleCollection& input) const override;
 
+  StatusCode finalize() override;
+
 private:
-  Gaudi::Property<int> m_resonancePDG{this, "ResonancePDG", 111, "Particle decaying to Gamma Gamma"};
+  Gaudi::Property<int> m_resonancePDG{this, "ResonancePDG", 111, "PDG of the resonance decaying in the Topology"};
 
-  Gaudi::Property<float> m_resonanceMass{this, "ResonanceMass", 0.135f,
-                                         "Nominal Mass of Particle Decaying to Gamma Gamma (GeV)"};
+  Gaudi::Property<float> m_resonanceMass{this, "ResonanceMass", 0.135f, "Nominal mass of the resonance (GeV)"};
 
   Gaudi::Property<float> m_maxDeltaM{this, "MaxDeltaM", 0.040f,
-                                     "Maximum difference between candidate mass and GammaGama Resonance mass (GeV)"};
+                                     "Maximum difference between candidate mass and resonance mass (GeV)"};
 
   Gaudi::Property<double> m_fitProbabilityCut{this, "MinFitProbability", 0.001, "Minimum fit probability"};
 
   Gaudi::Property<std::string> m_fitterType{this, "Fitter", "OPALFitter",
                                             "Which fitter to use. Choices: OPALFitter, NewFitter, NewtonFitter"};
 
-private:
-  std::unique_ptr<BaseFitter> createFitter() const;
-
-  struct FitResult {
-    double fitProbability{};
-    edm4hep::LorentzVectorE fittedParticle;
-    std::vector<double> covarianceMatrix;
-  };
-
-  std::optional<FitResult> performKinematicFit(const edm4hep::LorentzVectorE& gamma1,
-                                               const edm4hep::LorentzVectorE& gamma2) const;
-
-  edm4hep::MutableReconstructedParticle createParticle(const FitResult& fitResult,
-                                                       const edm4hep::ReconstructedParticle& gamma1,
-                                                       const edm4hep::ReconstructedParticle& gamma2) const;
+  Gaudi::Property<std::string> m_topology{
+      this, "Topology", "GammaGamma",
+      "Decay topology of the resonance. Choices: GammaGamma, LeptonLepton, ThreeBody (three photons)"};
+
+  // Axes of the monitoring histograms as (number of bins, min, max). With 0
+  // bins the axis is derived from the resonance properties in initialize
+  Gaudi::Property<std::tuple<unsigned, double, double>> m_prefitMassAxis{
+      this, "PrefitMassAxis", {0, 0., 0.},
+      "Binning of the prefit mass histogram (nBins, min, max) in GeV. Default: ResonanceMass +- MaxDeltaM"};
+
+  Gaudi::Property<std::tuple<unsigned, double, double>> m_energyAxis{
+      this, "EnergyAxis", {0, 0., 0.},
+      "Binning of the candidate energy in the fit delta M profile (nBins, min, max) in GeV. "
+      "Default: 0 to max(50, 2 * ResonanceMass)"};
+
+  Gaudi::Property<std::string> m_histStateFile{
+      this, "HistogramStateFile", "",
+      "File to write the (mergeable) state of the monitoring histograms to. Nothing is written if empty"};
+
+  // Monitoring histograms, these can be filled concurrently without locking.
+  // Booked in initialize, once the axes are configured
+  mutable std::optional<kinfit::hist::Histogram1D> m_prefitMassHist;
+  mutable std::optional<kinfit::hist::Histogram1D> m_fitProbHist;
+  mutable std::optional<kinfit::hist::Profile1D> m_fitDeltaMHist;
+
+  // The configuration of the finder, resolved from the properties in initialize
+  kinfit::ResonanceFinderConfig m_config{};
+
+  // The finder for the configured fitter and topology, which are resolved at
+  // compile time. Created once in initialize
+  std::unique_ptr<kinfit::IResonanceFinder> m_finder;
 };
@@ -0,0 +1,80 @@
+#include "KinematicFit.hpp"
+
+#include <edm4hep/Constants.h>
+#include <edm4hep/utils/vector_utils.h>
+
+#include <Eigen/Dense>
+
+namespace kinfit {
+
+edm4hep::MutableReconstructedParticle createParticle(const FitResult& fitResult,
+                                                     std::span<const edm4hep::ReconstructedParticle> daughters,
+                                                     int pdg, float mass) {
+  return createParticle(fitResult, daughters, daughters, pdg, mass);
+}
+
+edm4hep::MutableReconstructedParticle createParticle(const FitResult& fitResult,
+                                                     std::span<const edm4hep::ReconstructedParticle> daughters,
+                                                     std::span<const edm4hep::ReconstructedParticle> fitParticles,
+                                                     int pdg, float mass) {
+  auto recoPart = edm4hep::MutableReconstructedParticle{};
+
+  const auto& p4 = fitResult.fittedParticle;
+  // Kinematics from fit
+  recoPart.setEnergy(p4.E());
+  recoPart.getMomentum().x = p4.X();
+  recoPart.getMomentum().y = p4.Y();
+  recoPart.getMomentum().z = p4.Z();
+  recoPart.setGoodnessOfPID(fitResult.fitProbability);
+
+  // PDG and mass as configured
+  recoPart.setPDG(pdg);
+  recoPart.setMass(mass);
+
+  for (const auto& daughter : daughters) {
+    recoPart.addToParticles(daughter);
+  }
+
+  // Convert the covariance matrix back to px, py, pz, E from the (E_i,
+  // theta_i, phi_i) coordinate system of the fit particles, via:
+  // V' = J^T * V * J, where J is the jacobian matrix of the transfomration
+  const auto nrows = static_cast<Eigen::Index>(3 * fitParticles.size()); // Dimensions of the fit
+  constexpr int ncols = 4;                                                // Dimensions of result
+  if (static_cast<Eigen::Index>(fitResult.covarianceMatrix.size()) == nrows * nrows) {
+    auto J = Eigen::MatrixXd(nrows, ncols);
+    for (size_t i = 0; i < fitParticles.size(); ++i) {
+      const auto& particle = fitParticles[i];
+      const auto e = particle.getEnergy();
+      const auto p = particle.getMomentum();
+      const auto pt = edm4hep::utils::pt(particle);
+      const auto r = static_cast<Eigen::Index>(3 * i);
+      // clang-format off
+      J.row(r)     << p.x / e,         p.y / e,         p.z / e, 1.0;
+      J.row(r + 1) << p.x * p.z / pt,  p.y * p.z / pt,  -pt,     0.0;
+      J.row(r + 2) << -p.y,            p.x,             0.0,     0.0;
+      // clang-format on
+    }
+    const auto V = Eigen::Map<const Eigen::MatrixXd>(fitResult.covarianceMatrix.data(), nrows, nrows);
+    const Eigen::Matrix4d vP = J.transpose() * V * J;
+
+    auto& cov = recoPart.getCovMatrix();
+    using enum edm4hep::FourMomCoords;
+    cov.setValue(vP(0, 0), x, x);
+    cov.setValue(vP(0, 1), x, y);
+    cov.setValue(vP(0, 2), x, z);
+    cov.setValue(vP(0, 3), x, t);
+
+    cov.setValue(vP(1, 1), y, y);
+    cov.setValue(vP(1, 2), y, z);
+    cov.setValue(vP(1, 3), y, t);
+
+    cov.setValue(vP(2, 2), z, z);
+    cov.setValue(vP(2, 3), z, t);
+
+    cov.setValue(vP(3, 3), t, t);
+  }
+
+  return recoPart;
+}
+
+} // namespace kinfit
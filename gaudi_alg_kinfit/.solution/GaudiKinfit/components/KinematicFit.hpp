@@ -0,0 +1,133 @@
+#pragma once
+
+#include <JetFitObject.h>
+#include <MassConstraint.h>
+
+#include <edm4hep/MutableReconstructedParticle.h>
+#include <edm4hep/ReconstructedParticle.h>
+#include <edm4hep/utils/kinematics.h>
+
+#include <cstddef>
+#include <deque>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace kinfit {
+
+struct FitResult {
+  double fitProbability{};
+  edm4hep::LorentzVectorE fittedParticle;
+  std::vector<double> covarianceMatrix;
+};
+
+/// The state of the fitter after a kinematic fit, also for fits that did not
+/// converge. Only meant for diagnostics
+struct FitStatus {
+  int error{};
+  int nIterations{};
+  double fitProbability{};
+  int covDim{};
+};
+
+/// The errors on (E, theta, phi) and the mass with which a particle enters
+/// the fit as a JetFitObject
+struct FitObjectParams {
+  double dE{};
+  double dTheta{};
+  double dPhi{};
+  double mass{};
+};
+
+/// A mass constraint on a subset of the particles in a kinematic fit
+struct MassConstraintSpec {
+  double mass{};
+  /// Indices of the constrained particles
+  std::vector<std::size_t> particles;
+};
+
+/// Run a kinematic fit of the passed particles with (possibly several) mass
+/// constraints, using a fitter of type FitterT. The fitted particle is the sum
+/// of all fitted particles. Returns an empty optional if the fit did not
+/// converge. If status is passed, it is filled in either case
+template <typename FitterT>
+std::optional<FitResult> performKinematicFit(std::span<const edm4hep::LorentzVectorE> particles,
+                                             std::span<const FitObjectParams> params,
+                                             std::span<const MassConstraintSpec> constraints,
+                                             FitStatus* status = nullptr) {
+  // The fitter only keeps pointers to the fit objects and constraints, so
+  // these must not be moved once they have been added
+  auto fitObjects = std::deque<JetFitObject>{};
+  for (size_t i = 0; i < particles.size(); ++i) {
+    const auto& p4 = particles[i];
+    const auto& par = params[i];
+    fitObjects.emplace_back(p4.E(), p4.Theta(), p4.Phi(), par.dE, par.dTheta, par.dPhi, par.mass);
+  }
+
+  auto massConstraints = std::deque<MassConstraint>{};
+  for (const auto& constraint : constraints) {
+    auto& mc = massConstraints.emplace_back(constraint.mass);
+    for (const auto i : constraint.particles) {
+      mc.addToFOList(fitObjects[i]);
+    }
+  }
+
+  FitterT fitter;
+  for (auto& fitObject : fitObjects) {
+    fitter.addFitObject(fitObject);
+  }
+  for (auto& mc : massConstraints) {
+    fitter.addConstraint(mc);
+  }
+
+  const auto fitProbability = fitter.fit();
+  int covDim;
+  const double* cov = fitter.getGlobalCovarianceMatrix(covDim);
+  if (status) {
+    *status = {fitter.getError(), fitter.getIterations(), fitProbability, covDim};
+  }
+  if (fitter.getError() != 0) {
+    return std::nullopt;
+  }
+
+  FitResult result;
+  result.fitProbability = fitProbability;
+  for (const auto& fitObject : fitObjects) {
+    result.fittedParticle += edm4hep::LorentzVectorE(fitObject.getPx(), fitObject.getPy(), fitObject.getPz(),
+                                                     fitObject.getE());
+  }
+  // Store covariance matrix if available
+  if (covDim > 0 && cov != nullptr) {
+    result.covarianceMatrix.assign(cov, cov + covDim * covDim);
+  }
+
+  return result;
+}
+
+/// Run a kinematic fit of the passed particles constraining their combined
+/// mass, using a fitter of type FitterT
+template <typename FitterT>
+std::optional<FitResult> performKinematicFit(std::span<const edm4hep::LorentzVectorE> particles,
+                                             std::span<const FitObjectParams> params, double mass,
+                                             FitStatus* status = nullptr) {
+  auto constraint = MassConstraintSpec{mass, std::vector<std::size_t>(particles.size())};
+  std::iota(constraint.particles.begin(), constraint.particles.end(), 0);
+  return performKinematicFit<FitterT>(particles, params, std::span(&constraint, 1), status);
+}
+
+/// Create the resonance particle from the fit results, with the daughters
+/// that went into the fit
+edm4hep::MutableReconstructedParticle createParticle(const FitResult& fitResult,
+                                                     std::span<const edm4hep::ReconstructedParticle> daughters,
+                                                     int pdg, float mass);
+
+/// Create the resonance particle from the fit results, in case the particles
+/// that went into the fit are not the daughters themselves but e.g. the
+/// daughters of the daughters
+edm4hep::MutableReconstructedParticle createParticle(const FitResult& fitResult,
+                                                     std::span<const edm4hep::ReconstructedParticle> daughters,
+                                                     std::span<const edm4hep::ReconstructedParticle> fitParticles,
+                                                     int pdg, float mass);
+
+} // namespace kinfit
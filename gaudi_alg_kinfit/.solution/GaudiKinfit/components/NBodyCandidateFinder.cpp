@@ -0,0 +1,177 @@
+#include "NBodyCandidateFinder.hpp"
+
+#include "Combinatorics.hpp"
+#include "KinematicFit.hpp"
+#include "ResonanceFinder.hpp"
+
+#include <NewFitterGSL.h>
+#include <NewtonFitterGSL.h>
+#include <OPALFitterGSL.h>
+
+#include <fmt/format.h>
+
+#include <numeric>
+#include <stdexcept>
+
+namespace kinfit {
+
+struct NBodyFinderConfig {
+  int pdg{};
+  float mass{};
+  bool constrainDaughterMasses{};
+  double minFitProbability{};
+};
+
+class INBodyFinder {
+public:
+  virtual ~INBodyFinder() = default;
+
+  virtual edm4hep::ReconstructedParticleCollection
+  find(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs) const = 0;
+};
+
+/// The N-body finder for a fitter type that is fixed at compile time
+template <typename FitterT>
+class NBodyFinder final : public INBodyFinder {
+public:
+  NBodyFinder(CombinationBuilder builder, const NBodyFinderConfig& config)
+      : m_builder(std::move(builder)), m_config(config) {}
+
+  edm4hep::ReconstructedParticleCollection
+  find(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs) const override {
+    auto output = edm4hep::ReconstructedParticleCollection();
+
+    auto combInputs = std::vector<CombinatoricsInput>{};
+    combInputs.reserve(inputs.size());
+    for (const auto* input : inputs) {
+      combInputs.emplace_back(*input);
+    }
+
+    // Scratch space that is re-used for all combinations
+    auto daughters = std::vector<edm4hep::ReconstructedParticle>{};
+    auto fitParticles = std::vector<edm4hep::ReconstructedParticle>{};
+    auto fitP4s = std::vector<edm4hep::LorentzVectorE>{};
+    auto fitParams = std::vector<FitObjectParams>{};
+    auto constraints = std::vector<MassConstraintSpec>{};
+
+    m_builder.forEach(combInputs, [&](std::span<const std::size_t> indices, const edm4hep::LorentzVectorE&) {
+      daughters.clear();
+      fitParticles.clear();
+      fitP4s.clear();
+      fitParams.clear();
+      constraints.clear();
+
+      for (std::size_t d = 0; d < indices.size(); ++d) {
+        const auto& input = combInputs[m_builder.daughterInput(d)];
+        const auto i = indices[d];
+        const auto daughter = (*input.collection)[i];
+        daughters.push_back(daughter);
+
+        const auto leaves = input.leavesOf(i);
+        if (m_config.constrainDaughterMasses && daughter.getParticles().size() > 0) {
+          auto& constraint = constraints.emplace_back();
+          constraint.mass = daughter.getMass();
+          constraint.particles.resize(leaves.size());
+          std::iota(constraint.particles.begin(), constraint.particles.end(), fitParticles.size());
+        }
+        for (const auto& leaf : leaves) {
+          const auto p4 = edm4hep::utils::p4(leaf, edm4hep::utils::UseEnergy);
+          fitParticles.push_back(leaf);
+          fitP4s.push_back(p4);
+          // Charged particles enter the fit with the tracker resolution
+          fitParams.push_back(leaf.getCharge() != 0 ? Lepton::fitObjectParams(p4) : Photon::fitObjectParams(p4));
+        }
+      }
+
+      auto& constraint = constraints.emplace_back();
+      constraint.mass = m_config.mass;
+      constraint.particles.resize(fitParticles.size());
+      std::iota(constraint.particles.begin(), constraint.particles.end(), 0);
+
+      const auto fitResult = performKinematicFit<FitterT>(fitP4s, fitParams, constraints);
+      if (!fitResult || fitResult->fitProbability < m_config.minFitProbability) {
+        return;
+      }
+
+      output.push_back(createParticle(*fitResult, daughters, fitParticles, m_config.pdg, m_config.mass));
+    });
+
+    return output;
+  }
+
+private:
+  CombinationBuilder m_builder;
+  NBodyFinderConfig m_config;
+};
+
+namespace {
+  std::unique_ptr<INBodyFinder> makeNBodyFinder(const std::string& fitterType, CombinationBuilder builder,
+                                                const NBodyFinderConfig& config) {
+    if (fitterType == "OPALFitter") {
+      return std::make_unique<NBodyFinder<OPALFitterGSL>>(std::move(builder), config);
+    } else if (fitterType == "NewFitter") {
+      return std::make_unique<NBodyFinder<NewFitterGSL>>(std::move(builder), config);
+    } else if (fitterType == "NewtonFitter") {
+      return std::make_unique<NBodyFinder<NewtonFitterGSL>>(std::move(builder), config);
+    }
+    throw std::invalid_argument("Invalid fitter type: " + fitterType +
+                                ". Allowed values are: OPALFitter, NewFitter, NewtonFitter");
+  }
+} // namespace
+
+} // namespace kinfit
+
+NBodyCandidateFinder::NBodyCandidateFinder(const std::string& name, ISvcLocator* svcLoc)
+    : Transformer(name, svcLoc, {KeyValues("InputCollections", {"GammaGammaCandidates"})},
+                  {KeyValues("OutputCollection", {"NBodyCandidates"})}) {}
+
+NBodyCandidateFinder::~NBodyCandidateFinder() = default;
+
+StatusCode NBodyCandidateFinder::initialize() {
+  auto sc = Transformer::initialize();
+  if (sc.isFailure()) {
+    return sc;
+  }
+
+  const auto nInputs = inputLocations("InputCollections").size();
+  auto daughterInputs = std::vector<std::size_t>{};
+  for (const auto input : m_daughterInputs.value()) {
+    if (input < 0) {
+      error() << "DaughterInputs must not contain negative indices" << endmsg;
+      return StatusCode::FAILURE;
+    }
+    if (static_cast<std::size_t>(input) >= nInputs) {
+      error() << fmt::format("DaughterInputs index {} is out of range, there are only {} InputCollections", input,
+                             nInputs)
+              << endmsg;
+      return StatusCode::FAILURE;
+    }
+    daughterInputs.push_back(input);
+  }
+
+  try {
+    auto builder = kinfit::CombinationBuilder(std::move(daughterInputs), m_resonanceMass.value(), m_maxDeltaM.value(),
+                                              m_totalCharge.value());
+    m_finder = kinfit::makeNBodyFinder(m_fitterType.value(), std::move(builder),
+                                       {m_resonancePDG.value(), m_resonanceMass.value(),
+                                        m_constrainDaughterMasses.value(), m_fitProbabilityCut.value()});
+  } catch (const std::invalid_argument& ex) {
+    error() << ex.what() << endmsg;
+    return StatusCode::FAILURE;
+  }
+
+  return StatusCode::SUCCESS;
+}
+
+edm4hep::ReconstructedParticleCollection
+NBodyCandidateFinder::operator()(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs) const {
+  auto output = m_finder->find(inputs);
+
+  debug() << fmt::format("Found {} {} candidates from {} input collections", output.size(), m_resonancePDG.value(),
+                         inputs.size())
+          << endmsg;
+
+  return output;
+}
+
+DECLARE_COMPONENT(NBodyCandidateFinder)
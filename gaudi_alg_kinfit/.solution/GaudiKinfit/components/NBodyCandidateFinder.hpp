@@ -0,0 +1,58 @@
+#pragma once
+
+#include <k4FWCore/Transformer.h>
+
+#include <edm4hep/ReconstructedParticleCollection.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kinfit {
+class INBodyFinder;
+}
+
+/// Build candidates for a decay into an arbitrary number of daughters, e.g.
+/// eta -> pi0 pi0 pi0 or omega -> pi+ pi- pi0, where each daughter is taken from
+/// one of the input collections. Daughters that have been reconstructed from
+/// other particles themselves (e.g. pi0 candidates from the
+/// GammaGammaCandidateFinder) are resolved into their daughters for the
+/// kinematic fit, and their masses can be constrained in addition to the mass
+/// of the resonance.
+struct NBodyCandidateFinder final
+    : public k4FWCore::Transformer<edm4hep::ReconstructedParticleCollection(
+          const std::vector<const edm4hep::ReconstructedParticleCollection*>&)> {
+
+  NBodyCandidateFinder(const std::string& name, ISvcLocator* svcLoc);
+  ~NBodyCandidateFinder();
+
+  StatusCode initialize() override;
+
+  edm4hep::ReconstructedParticleCollection
+  operator()(const std::vector<const edm4hep::ReconstructedParticleCollection*>& inputs) const override;
+
+private:
+  Gaudi::Property<std::vector<int>> m_daughterInputs{
+      this, "DaughterInputs", {0, 0, 0},
+      "For every daughter the index of the input collection (in InputCollections) it is taken from"};
+
+  Gaudi::Property<int> m_resonancePDG{this, "ResonancePDG", 221, "PDG of the decaying particle"};
+
+  Gaudi::Property<float> m_resonanceMass{this, "ResonanceMass", 0.547862f, "Nominal mass of the decaying particle"};
+
+  Gaudi::Property<float> m_maxDeltaM{this, "MaxDeltaM", 0.1f,
+                                     "Maximum difference between candidate mass and resonance mass (GeV)"};
+
+  Gaudi::Property<int> m_totalCharge{this, "TotalCharge", 0, "Required total charge of the daughters"};
+
+  Gaudi::Property<bool> m_constrainDaughterMasses{
+      this, "ConstrainDaughterMasses", true,
+      "Add a mass constraint for every composite daughter, using the mass stored in the daughter"};
+
+  Gaudi::Property<double> m_fitProbabilityCut{this, "MinFitProbability", 0.001, "Minimum fit probability"};
+
+  Gaudi::Property<std::string> m_fitterType{this, "Fitter", "OPALFitter",
+                                            "Which fitter to use. Choices: OPALFitter, NewFitter, NewtonFitter"};
+
+  std::unique_ptr<kinfit::INBodyFinder> m_finder;
+};
@@ -0,0 +1,41 @@
+#include "ResonanceFinder.hpp"
+
+#include <NewFitterGSL.h>
+#include <NewtonFitterGSL.h>
+#include <OPALFitterGSL.h>
+
+#include <stdexcept>
+
+namespace kinfit {
+
+namespace {
+  template <typename FitterT>
+  std::unique_ptr<IResonanceFinder> makeWithFitter(const std::string& topology, const ResonanceFinderConfig& config,
+                                                   const FinderHistograms& histograms, const FinderLog& log) {
+    if (topology == "GammaGamma") {
+      return std::make_unique<ResonanceFinder<FitterT, GammaGamma>>(config, histograms, log);
+    } else if (topology == "LeptonLepton") {
+      return std::make_unique<ResonanceFinder<FitterT, LeptonLepton>>(config, histograms, log);
+    } else if (topology == "ThreeBody") {
+      return std::make_unique<ResonanceFinder<FitterT, ThreeBody>>(config, histograms, log);
+    }
+    throw std::invalid_argument("Invalid topology: " + topology +
+                                ". Allowed values are: GammaGamma, LeptonLepton, ThreeBody");
+  }
+} // namespace
+
+std::unique_ptr<IResonanceFinder> makeResonanceFinder(const std::string& fitterType, const std::string& topology,
+                                                      const ResonanceFinderConfig& config,
+                                                      const FinderHistograms& histograms, const FinderLog& log) {
+  if (fitterType == "OPALFitter") {
+    return makeWithFitter<OPALFitterGSL>(topology, config, histograms, log);
+  } else if (fitterType == "NewFitter") {
+    return makeWithFitter<NewFitterGSL>(topology, config, histograms, log);
+  } else if (fitterType == "NewtonFitter") {
+    return makeWithFitter<NewtonFitterGSL>(topology, config, histograms, log);
+  }
+  throw std::invalid_argument("Invalid fitter type: " + fitterType +
+                              ". Allowed values are: OPALFitter, NewFitter, NewtonFitter");
+}
+
+} // namespace kinfit
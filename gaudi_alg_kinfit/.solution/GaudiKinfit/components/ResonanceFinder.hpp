@@ -0,0 +1,231 @@
+#pragma once
+
+#include "AngularIndex.hpp"
+#include "KinematicFit.hpp"
+
+#include "GaudiKinfit/Histograms.h"
+
+#include <edm4hep/ReconstructedParticleCollection.h>
+#include <edm4hep/utils/kinematics.h>
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kinfit {
+
+/// Photons enter the fit with the (hard-wired) calorimeter resolution
+struct Photon {
+  static FitObjectParams fitObjectParams(const edm4hep::LorentzVectorE& p4) {
+    const auto sqrtE = std::sqrt(p4.E());
+    return {0.16 * sqrtE, 0.001 / sqrtE, 0.001 / sqrtE, 0.0};
+  }
+};
+
+/// Leptons enter the fit with an approximate tracker resolution of
+/// sigma(1/p) = 2e-5 / GeV
+struct Lepton {
+  static FitObjectParams fitObjectParams(const edm4hep::LorentzVectorE& p4) {
+    return {2e-5 * p4.E() * p4.E(), 1e-4, 1e-4, p4.M()};
+  }
+};
+
+/// A decay into NDaughters daughters of the same type, taken from one input
+/// collection
+template <std::size_t NDaughters, typename DaughterT>
+struct Topology {
+  static constexpr std::size_t nDaughters = NDaughters;
+  using Daughter = DaughterT;
+};
+
+using GammaGamma = Topology<2, Photon>;
+using LeptonLepton = Topology<2, Lepton>;
+using ThreeBody = Topology<3, Photon>;
+
+struct ResonanceFinderConfig {
+  int pdg{};
+  float mass{};
+  float maxDeltaM{};
+  double minFitProbability{};
+};
+
+/// Optional monitoring histograms that are filled by the finder
+struct FinderHistograms {
+  hist::Histogram1D* prefitMass{nullptr};
+  hist::Histogram1D* fitProbability{nullptr};
+  hist::Profile1D* fitDeltaM{nullptr};
+};
+
+/// Optional sinks for the diagnostic messages of the finder. The messages for
+/// a level are only formatted if its sink is set
+struct FinderLog {
+  std::function<void(const std::string&)> debug;
+  std::function<void(const std::string&)> verbose;
+};
+
+/// Runtime interface of the resonance finders, such that the concrete finder
+/// only has to be chosen once during initialization
+class IResonanceFinder {
+public:
+  virtual ~IResonanceFinder() = default;
+
+  /// Build all resonance candidates from the input particles that are within
+  /// the configured mass window and pass the kinematic fit
+  virtual edm4hep::ReconstructedParticleCollection
+  find(const edm4hep::ReconstructedParticleCollection& input) const = 0;
+};
+
+/// Resonance finder with the fitter type and the decay topology fixed at
+/// compile time. The loops over all combinations of daughters are generated
+/// for the number of daughters of the topology.
+///
+/// Since the mass of any pair of daughters can be at most the upper edge of
+/// the mass window, all daughters have to be within an opening angle of the
+/// first one that shrinks with their momenta (see maxOpeningAngle). Only
+/// these neighbours are looked up via an AngularIndex, instead of trying all
+/// combinations.
+template <typename FitterT, typename TopologyT>
+class ResonanceFinder final : public IResonanceFinder {
+  static constexpr auto N = TopologyT::nDaughters;
+  using Daughter = typename TopologyT::Daughter;
+
+public:
+  ResonanceFinder(const ResonanceFinderConfig& config, const FinderHistograms& histograms, const FinderLog& log = {})
+      : m_config(config), m_histograms(histograms), m_log(log) {}
+
+  edm4hep::ReconstructedParticleCollection find(const edm4hep::ReconstructedParticleCollection& input) const override {
+    auto output = edm4hep::ReconstructedParticleCollection();
+    if (input.size() < N) {
+      return output;
+    }
+
+    // Compute the four momenta only once instead of for every combination
+    auto p4s = std::vector<edm4hep::LorentzVectorE>{};
+    p4s.reserve(input.size());
+    for (const auto& particle : input) {
+      p4s.emplace_back(edm4hep::utils::p4(particle, edm4hep::utils::UseEnergy));
+    }
+
+    const auto index = AngularIndex(p4s);
+    const auto maxMass = m_config.mass + m_config.maxDeltaM;
+    auto indices = std::array<std::size_t, N>{};
+    auto neighbours = std::vector<std::size_t>{};
+    for (std::size_t i = 0; i + N <= p4s.size(); ++i) {
+      neighbours.clear();
+      index.forEachNeighbour(i, maxOpeningAngle(maxMass, index.momentum(i), index.minMomentum()),
+                             [&neighbours, i](std::size_t j) {
+                               if (j > i) {
+                                 neighbours.push_back(j);
+                               }
+                             });
+      // Keep the order of the candidates independent of the index
+      std::sort(neighbours.begin(), neighbours.end());
+
+      indices[0] = i;
+      combine<1>(input, p4s, neighbours, indices, 0, p4s[i], output);
+    }
+
+    return output;
+  }
+
+private:
+  /// Choose the daughter at position Depth from the candidates after first,
+  /// and recurse until all daughters have been chosen
+  template <std::size_t Depth>
+  void combine(const edm4hep::ReconstructedParticleCollection& input, const std::vector<edm4hep::LorentzVectorE>& p4s,
+               const std::vector<std::size_t>& candidates, std::array<std::size_t, N>& indices, std::size_t first,
+               const edm4hep::LorentzVectorE& partialP4, edm4hep::ReconstructedParticleCollection& output) const {
+    for (std::size_t c = first; c + (N - Depth) <= candidates.size(); ++c) {
+      const auto i = candidates[c];
+      indices[Depth] = i;
+      const auto p4 = partialP4 + p4s[i];
+      if constexpr (Depth + 1 < N) {
+        combine<Depth + 1>(input, p4s, candidates, indices, c + 1, p4, output);
+      } else {
+        evaluate(input, p4s, indices, p4, output);
+      }
+    }
+  }
+
+  void evaluate(const edm4hep::ReconstructedParticleCollection& input, const std::vector<edm4hep::LorentzVectorE>& p4s,
+                const std::array<std::size_t, N>& indices, const edm4hep::LorentzVectorE& combinedP4,
+                edm4hep::ReconstructedParticleCollection& output) const {
+    const auto prefitMass = combinedP4.M();
+    if (std::abs(prefitMass - m_config.mass) > m_config.maxDeltaM) {
+      log(m_log.debug, "Combination of particles {} with combined mass {} too far away from configured resonance mass",
+          indices, prefitMass);
+      return;
+    }
+    fill(m_histograms.prefitMass, prefitMass);
+
+    auto daughterP4s = std::array<edm4hep::LorentzVectorE, N>{};
+    auto params = std::array<FitObjectParams, N>{};
+    for (std::size_t i = 0; i < N; ++i) {
+      daughterP4s[i] = p4s[indices[i]];
+      params[i] = Daughter::fitObjectParams(daughterP4s[i]);
+    }
+
+    log(m_log.debug, "Performing kinematic fit for particles {}", indices);
+    auto status = FitStatus{};
+    const auto fitResult = performKinematicFit<FitterT>(daughterP4s, params, m_config.mass, &status);
+    log(m_log.verbose,
+        "Constrained fit results RC: {}, No. of iterations {}, fit probability = {}, cov matrix dimension = {}",
+        status.error, status.nIterations, status.fitProbability, status.covDim);
+    if (!fitResult) {
+      return;
+    }
+    fill(m_histograms.fitProbability, fitResult->fitProbability);
+    if (fitResult->fitProbability < m_config.minFitProbability) {
+      log(m_log.debug, "Fit probability {} smaller than configured minimum fit probability",
+          fitResult->fitProbability);
+      return;
+    }
+    if (m_histograms.fitDeltaM) {
+      m_histograms.fitDeltaM->fill(fitResult->fittedParticle.E(), fitResult->fittedParticle.M() - prefitMass);
+    }
+
+    const auto daughters = [&]<std::size_t... I>(std::index_sequence<I...>) {
+      return std::array{input[indices[I]]...};
+    }(std::make_index_sequence<N>{});
+    const auto& p4 = fitResult->fittedParticle;
+    log(m_log.debug, "Creating resonance particle (x,y,z,E) = ({}, {}, {}, {})", p4.X(), p4.Y(), p4.Z(), p4.E());
+    output.push_back(createParticle(*fitResult, daughters, m_config.pdg, m_config.mass));
+  }
+
+  static void fill(hist::Histogram1D* histogram, double value) {
+    if (histogram) {
+      histogram->fill(value);
+    }
+  }
+
+  template <typename... Args>
+  static void log(const std::function<void(const std::string&)>& sink, fmt::format_string<Args...> format,
+                  Args&&... args) {
+    if (sink) {
+      sink(fmt::format(format, std::forward<Args>(args)...));
+    }
+  }
+
+  ResonanceFinderConfig m_config;
+  FinderHistograms m_histograms;
+  FinderLog m_log;
+};
+
+/// Create the resonance finder for the given fitter type (OPALFitter,
+/// NewFitter or NewtonFitter) and topology (GammaGamma, LeptonLepton or
+/// ThreeBody). Throws a std::invalid_argument for unknown values
+std::unique_ptr<IResonanceFinder> makeResonanceFinder(const std::string& fitterType, const std::string& topology,
+                                                      const ResonanceFinderConfig& config,
+                                                      const FinderHistograms& histograms = {},
+                                                      const FinderLog& log = {});
+
+} // namespace kinfit
@@ -0,0 +1,29 @@
+#pragma once
+
+// Interface of the KinfitAllocationCounter library. This library replaces the
+// malloc family of functions with thin wrappers that count the allocations
+// of every thread before forwarding to glibc. It has to be preloaded to take
+// effect, e.g.
+//
+//   LD_PRELOAD=libKinfitAllocationCounter.so k4run options.py
+//
+// Users (like the AllocationAuditor) look up kinfit_allocation_counts at
+// runtime, so that they also work without the library being preloaded.
+
+#include <cstdint>
+
+extern "C" {
+
+struct KinfitAllocationCounts {
+  std::uint64_t nAllocs;
+  std::uint64_t nFrees;
+  std::uint64_t bytes;
+};
+
+/// The allocation counts of the calling thread since it started
+KinfitAllocationCounts kinfit_allocation_counts();
+}
+
+using KinfitAllocationCountsFunc = KinfitAllocationCounts (*)();
+
+inline constexpr const char* KinfitAllocationCountsSymbol = "kinfit_allocation_counts";
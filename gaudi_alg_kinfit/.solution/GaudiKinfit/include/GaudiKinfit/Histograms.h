@@ -0,0 +1,317 @@
+#pragma once
+
+// A small, header-only histogram library that can be filled concurrently from
+// several threads without locking (all bins are atomics), that can be merged
+// cheaply and that has a plain text serialized state. Conversion to ROOT
+// histograms lives in HistogramsROOT.h so that this header has no ROOT
+// dependency.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace kinfit::hist {
+
+/// A regularly binned axis. Bin 0 is the underflow and bin nBins + 1 the
+/// overflow bin (the same convention as ROOT)
+struct Axis {
+  unsigned nBins{};
+  double min{};
+  double max{};
+
+  std::size_t index(double x) const {
+    if (!(x >= min)) { // also catches NaN
+      return 0;
+    }
+    if (x >= max) {
+      return nBins + 1;
+    }
+    const auto bin = static_cast<std::size_t>((x - min) / (max - min) * nBins);
+    return 1 + std::min<std::size_t>(bin, nBins - 1);
+  }
+
+  /// Number of bins including under- and overflow
+  std::size_t size() const { return nBins + 2; }
+
+  bool operator==(const Axis&) const = default;
+};
+
+namespace detail {
+  /// Common storage for all histogram types. Every cell (bin) holds NMoments
+  /// accumulated values, e.g. the sum of weights and the sum of squared weights
+  template <std::size_t ND, std::size_t NMoments>
+  class BinnedStorage {
+  public:
+    BinnedStorage(std::string name, std::string title, std::array<Axis, ND> axes)
+        : m_name(std::move(name)), m_title(std::move(title)), m_axes(axes), m_data(nCells(axes) * NMoments) {
+      for (const auto& axis : m_axes) {
+        if (axis.nBins == 0 || !(axis.max > axis.min)) {
+          throw std::invalid_argument("Invalid axis definition for histogram " + m_name);
+        }
+      }
+    }
+
+    BinnedStorage(BinnedStorage&& other) noexcept
+        : m_name(std::move(other.m_name)), m_title(std::move(other.m_title)), m_axes(other.m_axes),
+          m_data(std::move(other.m_data)), m_entries(other.m_entries.load()) {}
+
+    BinnedStorage(const BinnedStorage&) = delete;
+    BinnedStorage& operator=(const BinnedStorage&) = delete;
+    BinnedStorage& operator=(BinnedStorage&&) = delete;
+
+    const std::string& name() const { return m_name; }
+    const std::string& title() const { return m_title; }
+    const std::array<Axis, ND>& axes() const { return m_axes; }
+    std::uint64_t entries() const { return m_entries.load(std::memory_order_relaxed); }
+
+    /// Number of cells including all under- and overflow bins
+    std::size_t nCells() const { return m_data.size() / NMoments; }
+
+  protected:
+    static std::size_t nCells(const std::array<Axis, ND>& axes) {
+      std::size_t n = 1;
+      for (const auto& axis : axes) {
+        n *= axis.size();
+      }
+      return n;
+    }
+
+    /// Global cell index, with the first axis running fastest (as in ROOT)
+    std::size_t cellIndex(const std::array<double, ND>& x) const {
+      std::size_t index = 0;
+      std::size_t stride = 1;
+      for (std::size_t d = 0; d < ND; ++d) {
+        index += m_axes[d].index(x[d]) * stride;
+        stride *= m_axes[d].size();
+      }
+      return index;
+    }
+
+    void add(std::size_t cell, const std::array<double, NMoments>& values) {
+      for (std::size_t m = 0; m < NMoments; ++m) {
+        m_data[cell * NMoments + m].fetch_add(values[m], std::memory_order_relaxed);
+      }
+      m_entries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    double moment(std::size_t cell, std::size_t m) const {
+      return m_data[cell * NMoments + m].load(std::memory_order_relaxed);
+    }
+
+    void mergeFrom(const BinnedStorage& other) {
+      if (m_axes != other.m_axes) {
+        throw std::invalid_argument("Cannot merge histograms " + m_name + " and " + other.m_name +
+                                    " with different binning");
+      }
+      for (std::size_t i = 0; i < m_data.size(); ++i) {
+        m_data[i].fetch_add(other.m_data[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      m_entries.fetch_add(other.entries(), std::memory_order_relaxed);
+    }
+
+    /// Write the state as two lines: a header with the kind, name, title,
+    /// number of entries and axes, followed by all the accumulated values
+    void write(std::ostream& os, std::string_view kind) const {
+      const auto precision = os.precision(std::numeric_limits<double>::max_digits10);
+      os << kind << ' ' << std::quoted(m_name) << ' ' << std::quoted(m_title) << ' ' << entries();
+      for (const auto& axis : m_axes) {
+        os << ' ' << axis.nBins << ' ' << axis.min << ' ' << axis.max;
+      }
+      os << '\n';
+      for (std::size_t i = 0; i < m_data.size(); ++i) {
+        os << (i ? " " : "") << m_data[i].load(std::memory_order_relaxed);
+      }
+      os << '\n';
+      os.precision(precision);
+    }
+
+    /// Read the state written by write, after the kind has already been
+    /// consumed from the stream
+    static BinnedStorage read(std::istream& is) {
+      std::string name, title;
+      std::uint64_t entries{};
+      std::array<Axis, ND> axes{};
+      is >> std::quoted(name) >> std::quoted(title) >> entries;
+      for (auto& axis : axes) {
+        is >> axis.nBins >> axis.min >> axis.max;
+      }
+      if (!is) {
+        throw std::runtime_error("Could not read histogram header");
+      }
+
+      auto storage = BinnedStorage(std::move(name), std::move(title), axes);
+      for (auto& value : storage.m_data) {
+        double v{};
+        is >> v;
+        value.store(v, std::memory_order_relaxed);
+      }
+      if (!is) {
+        throw std::runtime_error("Could not read bin contents of histogram " + storage.m_name);
+      }
+      storage.m_entries.store(entries, std::memory_order_relaxed);
+      return storage;
+    }
+
+  private:
+    std::string m_name;
+    std::string m_title;
+    std::array<Axis, ND> m_axes;
+    std::vector<std::atomic<double>> m_data;
+    std::atomic<std::uint64_t> m_entries{0};
+  };
+} // namespace detail
+
+/// 1D histogram, accumulating the sum of weights and of squared weights
+class Histogram1D : public detail::BinnedStorage<1, 2> {
+public:
+  static constexpr std::string_view kind = "H1";
+
+  Histogram1D(std::string name, std::string title, Axis axis)
+      : BinnedStorage(std::move(name), std::move(title), {axis}) {}
+
+  void fill(double x, double w = 1.0) { add(cellIndex({x}), {w, w * w}); }
+
+  double binContent(std::size_t bin) const { return moment(bin, 0); }
+  double binError(std::size_t bin) const { return std::sqrt(moment(bin, 1)); }
+
+  Histogram1D& operator+=(const Histogram1D& other) {
+    mergeFrom(other);
+    return *this;
+  }
+
+  void write(std::ostream& os) const { BinnedStorage::write(os, kind); }
+  static Histogram1D read(std::istream& is) { return Histogram1D(BinnedStorage::read(is)); }
+
+private:
+  explicit Histogram1D(BinnedStorage&& storage) : BinnedStorage(std::move(storage)) {}
+};
+
+/// 2D histogram, accumulating the sum of weights and of squared weights
+class Histogram2D : public detail::BinnedStorage<2, 2> {
+public:
+  static constexpr std::string_view kind = "H2";
+
+  Histogram2D(std::string name, std::string title, Axis xAxis, Axis yAxis)
+      : BinnedStorage(std::move(name), std::move(title), {xAxis, yAxis}) {}
+
+  void fill(double x, double y, double w = 1.0) { add(cellIndex({x, y}), {w, w * w}); }
+
+  /// Content of the bin with global index bin = ix + (nBinsX + 2) * iy
+  double binContent(std::size_t bin) const { return moment(bin, 0); }
+  double binError(std::size_t bin) const { return std::sqrt(moment(bin, 1)); }
+
+  Histogram2D& operator+=(const Histogram2D& other) {
+    mergeFrom(other);
+    return *this;
+  }
+
+  void write(std::ostream& os) const { BinnedStorage::write(os, kind); }
+  static Histogram2D read(std::istream& is) { return Histogram2D(BinnedStorage::read(is)); }
+
+private:
+  explicit Histogram2D(BinnedStorage&& storage) : BinnedStorage(std::move(storage)) {}
+};
+
+/// 1D profile, accumulating sum(w), sum(w^2), sum(w * y) and sum(w * y^2) in
+/// each bin
+class Profile1D : public detail::BinnedStorage<1, 4> {
+public:
+  static constexpr std::string_view kind = "P1";
+
+  Profile1D(std::string name, std::string title, Axis axis)
+      : BinnedStorage(std::move(name), std::move(title), {axis}) {}
+
+  void fill(double x, double y, double w = 1.0) { add(cellIndex({x}), {w, w * w, w * y, w * y * y}); }
+
+  double sumW(std::size_t bin) const { return moment(bin, 0); }
+  double sumW2(std::size_t bin) const { return moment(bin, 1); }
+  double sumWY(std::size_t bin) const { return moment(bin, 2); }
+  double sumWY2(std::size_t bin) const { return moment(bin, 3); }
+
+  double mean(std::size_t bin) const {
+    const auto w = sumW(bin);
+    return w != 0 ? sumWY(bin) / w : 0.0;
+  }
+
+  Profile1D& operator+=(const Profile1D& other) {
+    mergeFrom(other);
+    return *this;
+  }
+
+  void write(std::ostream& os) const { BinnedStorage::write(os, kind); }
+  static Profile1D read(std::istream& is) { return Profile1D(BinnedStorage::read(is)); }
+
+private:
+  explicit Profile1D(BinnedStorage&& storage) : BinnedStorage(std::move(storage)) {}
+};
+
+using AnyHistogram = std::variant<Histogram1D, Histogram2D, Profile1D>;
+
+/// Write the state of all passed histograms to the stream
+template <typename... Histograms>
+void writeHistograms(std::ostream& os, const Histograms&... histograms) {
+  (histograms.write(os), ...);
+}
+
+inline void writeHistograms(std::ostream& os, const std::vector<AnyHistogram>& histograms) {
+  for (const auto& histogram : histograms) {
+    std::visit([&os](const auto& h) { h.write(os); }, histogram);
+  }
+}
+
+/// Read all histograms from a stream that has been written by writeHistograms
+inline std::vector<AnyHistogram> readHistograms(std::istream& is) {
+  auto histograms = std::vector<AnyHistogram>{};
+  std::string kind;
+  while (is >> kind) {
+    if (kind == Histogram1D::kind) {
+      histograms.emplace_back(Histogram1D::read(is));
+    } else if (kind == Histogram2D::kind) {
+      histograms.emplace_back(Histogram2D::read(is));
+    } else if (kind == Profile1D::kind) {
+      histograms.emplace_back(Profile1D::read(is));
+    } else {
+      throw std::runtime_error("Unknown histogram kind: " + kind);
+    }
+  }
+  return histograms;
+}
+
+/// Merge all histograms from other into target. Histograms are matched by
+/// name, and histograms that are not yet present in target are appended
+inline void mergeHistograms(std::vector<AnyHistogram>& target, std::vector<AnyHistogram>&& other) {
+  const auto getName = [](const auto& h) -> const std::string& { return h.name(); };
+  for (auto& histogram : other) {
+    const auto& name = std::visit(getName, histogram);
+    auto it = std::find_if(target.begin(), target.end(),
+                           [&](const auto& h) { return std::visit(getName, h) == name; });
+    if (it == target.end()) {
+      target.emplace_back(std::move(histogram));
+      continue;
+    }
+    if (it->index() != histogram.index()) {
+      throw std::invalid_argument("Cannot merge histograms of different kinds with name " + name);
+    }
+    std::visit(
+        [&histogram](auto& h) {
+          using HistT = std::decay_t<decltype(h)>;
+          h += std::get<HistT>(histogram);
+        },
+        *it);
+  }
+}
+
+} // namespace kinfit::hist
@@ -0,0 +1,69 @@
+#pragma once
+
+// Conversion of the histograms from Histograms.h into their ROOT equivalents
+
+#include "GaudiKinfit/Histograms.h"
+
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TProfile.h>
+
+#include <memory>
+#include <variant>
+
+namespace kinfit::hist {
+
+inline std::unique_ptr<TH1D> toROOT(const Histogram1D& hist) {
+  const auto& axis = hist.axes()[0];
+  auto rootHist = std::make_unique<TH1D>(hist.name().c_str(), hist.title().c_str(), axis.nBins, axis.min, axis.max);
+  rootHist->Sumw2();
+  for (std::size_t bin = 0; bin < axis.size(); ++bin) {
+    rootHist->SetBinContent(bin, hist.binContent(bin));
+    rootHist->SetBinError(bin, hist.binError(bin));
+  }
+  rootHist->ResetStats();
+  rootHist->SetEntries(hist.entries());
+  return rootHist;
+}
+
+inline std::unique_ptr<TH2D> toROOT(const Histogram2D& hist) {
+  const auto& [xAxis, yAxis] = hist.axes();
+  auto rootHist = std::make_unique<TH2D>(hist.name().c_str(), hist.title().c_str(), xAxis.nBins, xAxis.min,
+                                         xAxis.max, yAxis.nBins, yAxis.min, yAxis.max);
+  rootHist->Sumw2();
+  // The global bin numbering is the same as in ROOT
+  for (std::size_t bin = 0; bin < hist.nCells(); ++bin) {
+    rootHist->SetBinContent(bin, hist.binContent(bin));
+    rootHist->SetBinError(bin, hist.binError(bin));
+  }
+  rootHist->ResetStats();
+  rootHist->SetEntries(hist.entries());
+  return rootHist;
+}
+
+inline std::unique_ptr<TProfile> toROOT(const Profile1D& hist) {
+  const auto& axis = hist.axes()[0];
+  auto rootHist =
+      std::make_unique<TProfile>(hist.name().c_str(), hist.title().c_str(), axis.nBins, axis.min, axis.max);
+  rootHist->Sumw2();
+  // A TProfile stores sum(w * y) as bin content, sum(w * y^2) as sumw2 and
+  // sum(w) and sum(w^2) as bin entries and bin sumw2
+  for (std::size_t bin = 0; bin < axis.size(); ++bin) {
+    rootHist->GetArray()[bin] = hist.sumWY(bin);
+    rootHist->GetSumw2()->GetArray()[bin] = hist.sumWY2(bin);
+    rootHist->SetBinEntries(bin, hist.sumW(bin));
+    rootHist->GetBinSumw2()->GetArray()[bin] = hist.sumW2(bin);
+  }
+  rootHist->ResetStats();
+  rootHist->SetEntries(hist.entries());
+  return rootHist;
+}
+
+/// Convert and write all histograms into the current ROOT directory
+inline void writeToROOT(const std::vector<AnyHistogram>& histograms) {
+  for (const auto& histogram : histograms) {
+    std::visit([](const auto& h) { toROOT(h)->Write(); }, histogram);
+  }
+}
+
+} // namespace kinfit::hist
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "GaudiKinfit/Histograms.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// A cache of per input file partial histograms, together with a manifest of
+/// the checksums of the input files from which they have been produced. This
+/// allows to only process new or changed input files on a re-run and merge
+/// their results with the cached ones.
+///
+/// The manifest is a plain text file in the cache directory. Its first line
+/// holds a hash of the definitions of the cached histograms, followed by one
+/// line per input file: path, size, modification time and checksum. The
+/// partial histograms are stored in the serialized histogram format, in a file
+/// named after the checksum of the input file.
+///
+/// The definitions are an arbitrary string that has to change whenever the
+/// cached results would change for the same input, e.g. the serialized state
+/// of the empty histograms together with a version of the code filling them.
+/// If they do not match the ones in the manifest, the whole cache is dropped.
+class IncrementalCache {
+public:
+  IncrementalCache(std::filesystem::path cacheDir, std::string_view definitions)
+      : m_cacheDir(std::move(cacheDir)), m_definitionsHash(hash(definitions)) {
+    std::filesystem::create_directories(m_cacheDir);
+    readManifest();
+  }
+
+  /// Get the partial histograms for an input file, either from the cache if
+  /// the input file has not changed, or by running processFile on it
+  template <typename ProcessFunc>
+  std::vector<kinfit::hist::AnyHistogram> get(const std::string& inputfile, ProcessFunc&& processFile) {
+    const auto entry = currentEntry(inputfile);
+    m_manifest[inputfile] = entry;
+
+    const auto stateFile = statePath(entry.checksum);
+    if (std::filesystem::exists(stateFile)) {
+      auto state = std::ifstream(stateFile);
+      ++m_nCached;
+      return kinfit::hist::readHistograms(state);
+    }
+
+    auto histograms = processFile(inputfile);
+    // Write to a temporary file first to not leave a truncated state file
+    // behind in case we get interrupted
+    const auto tmpFile = std::filesystem::path(stateFile).concat(".tmp");
+    {
+      auto state = std::ofstream(tmpFile);
+      kinfit::hist::writeHistograms(state, histograms);
+      if (!state) {
+        throw std::runtime_error("Could not write histogram state file " + tmpFile.string());
+      }
+    }
+    std::filesystem::rename(tmpFile, stateFile);
+    ++m_nProcessed;
+    return histograms;
+  }
+
+  /// Write the manifest. By default the entries of input files that have not
+  /// been passed to get in this run are kept, so that the cache can be shared
+  /// between runs over different subsets of the inputs. With prune only the
+  /// passed input files are kept, and all partial histograms that are no
+  /// longer referenced are removed from the cache
+  void writeManifest(const std::vector<std::string>& inputfiles, bool prune = false) {
+    if (prune) {
+      std::erase_if(m_manifest, [&inputfiles](const auto& entry) {
+        return std::find(inputfiles.begin(), inputfiles.end(), entry.first) == inputfiles.end();
+      });
+    }
+
+    auto usedStates = std::set<std::filesystem::path>{};
+    const auto tmpFile = manifestPath().concat(".tmp");
+    {
+      auto manifest = std::ofstream(tmpFile);
+      manifest << "definitions " << m_definitionsHash << '\n';
+      for (const auto& [file, entry] : m_manifest) {
+        manifest << std::quoted(file) << ' ' << entry.size << ' ' << entry.mtime << ' ' << entry.checksum << '\n';
+        usedStates.insert(statePath(entry.checksum));
+      }
+      if (!manifest) {
+        throw std::runtime_error("Could not write manifest " + tmpFile.string());
+      }
+    }
+    std::filesystem::rename(tmpFile, manifestPath());
+
+    if (prune) {
+      removeStates([&usedStates](const auto& path) { return !usedStates.contains(path); });
+    }
+  }
+
+  unsigned nCached() const { return m_nCached; }
+  unsigned nProcessed() const { return m_nProcessed; }
+  /// Whether the cache has been dropped because the histogram definitions
+  /// have changed since it has been written
+  bool invalidated() const { return m_invalidated; }
+
+private:
+  struct Entry {
+    std::uintmax_t size{};
+    std::int64_t mtime{};
+    std::string checksum;
+  };
+
+  std::filesystem::path manifestPath() const { return m_cacheDir / "manifest.txt"; }
+
+  std::filesystem::path statePath(const std::string& checksum) const { return m_cacheDir / (checksum + ".hists"); }
+
+  void readManifest() {
+    auto manifest = std::ifstream(manifestPath());
+    if (!manifest) {
+      return;
+    }
+    std::string key, definitionsHash;
+    if (!(manifest >> key >> definitionsHash) || key != "definitions" || definitionsHash != m_definitionsHash) {
+      // Also covers manifests written before the definitions were stored
+      m_invalidated = true;
+      removeStates([](const auto&) { return true; });
+      return;
+    }
+    std::string file;
+    Entry entry;
+    while (manifest >> std::quoted(file) >> entry.size >> entry.mtime >> entry.checksum) {
+      m_manifest[file] = entry;
+    }
+  }
+
+  /// Remove the partial histograms for which pred returns true
+  template <typename Pred>
+  void removeStates(Pred&& pred) const {
+    for (const auto& cached : std::filesystem::directory_iterator(m_cacheDir)) {
+      if (cached.path().extension() == ".hists" && pred(cached.path())) {
+        std::filesystem::remove(cached.path());
+      }
+    }
+  }
+
+  /// The manifest entry for the current state of the input file. The checksum
+  /// is only recomputed if size or modification time have changed
+  Entry currentEntry(const std::string& inputfile) const {
+    const auto size = std::filesystem::file_size(inputfile);
+    const auto mtime = std::filesystem::last_write_time(inputfile).time_since_epoch().count();
+    if (const auto it = m_manifest.find(inputfile);
+        it != m_manifest.end() && it->second.size == size && it->second.mtime == mtime) {
+      return it->second;
+    }
+    return {size, mtime, checksum(inputfile)};
+  }
+
+  /// 64 bit FNV-1a hash, continuing from the passed state
+  static std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = 14695981039346656037ull) {
+    for (const auto c : data) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  static std::string toHex(std::uint64_t hash) {
+    auto hex = std::ostringstream{};
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+  }
+
+  static std::string hash(std::string_view data) { return toHex(fnv1a(data)); }
+
+  /// Hash of the file contents
+  static std::string checksum(const std::string& inputfile) {
+    auto file = std::ifstream(inputfile, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Could not open input file " + inputfile);
+    }
+    auto state = fnv1a({});
+    auto buffer = std::array<char, 1 << 16>{};
+    while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+      state = fnv1a({buffer.data(), static_cast<std::size_t>(file.gcount())}, state);
+    }
+    return toHex(state);
+  }
+
+  std::filesystem::path m_cacheDir;
+  std::string m_definitionsHash;
+  std::map<std::string, Entry> m_manifest;
+  unsigned m_nCached{0};
+  unsigned m_nProcessed{0};
+  bool m_invalidated{false};
+};
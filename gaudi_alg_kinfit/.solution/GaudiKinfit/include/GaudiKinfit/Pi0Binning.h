@@ -0,0 +1,21 @@
+#pragma once
+
+// Binning of the pi0 histograms, shared by the GammaGammaCandidateFinder and
+// the standalone analysis executables
+
+#include "GaudiKinfit/Histograms.h"
+
+namespace kinfit::hist::pi0 {
+
+/// Mass of the (fitted) pi0 candidates
+inline constexpr Axis mass{100, 0.130, 0.139};
+/// Di-photon mass before the kinematic fit
+inline constexpr Axis prefitMass{100, 0.1, 0.19};
+/// Difference between the post- and prefit masses
+inline constexpr Axis fitDeltaM{100, -0.1, 0.1};
+/// Fit probability of the kinematic fit
+inline constexpr Axis fitProbability{100, 0., 1.};
+/// Energy of the pi0 candidates
+inline constexpr Axis energy{50, 0., 50.};
+
+} // namespace kinfit::hist::pi0
@@ -1,16 +1,63 @@
 #!/usr/bin/env python3
 
+import os
+import shlex
+
 from Gaudi.Configuration import INFO
 from k4FWCore import ApplicationMgr, IOSvc
+from k4FWCore.parseArgs import parser
 from Configurables import (
     RecoParticleFilter,
     GammaGammaCandidateFinder,
     EventDataSvc,
     AuditorSvc,
     AlgTimingAuditor,
+    AllocationAuditor,
+    AsyncOutputWriter,
+)
+
+parser.add_argument(
+    "--async-output",
+    action="store_true",
+    help="Write the output from a separate thread with the AsyncOutputWriter",
+)
+parser.add_argument(
+    "--checkpoint-file",
+    help="Store the progress of the job in this file, and resume from it if it "
+    "exists already. Implies --async-output",
+)
+parser.add_argument(
+    "--checkpoint-interval",
+    type=int,
+    default=1000,
+    help="Number of events between two checkpoints (default: %(default)s)",
 )
+parser.add_argument(
+    "--profile-allocations",
+    action="store_true",
+    help="Record the heap allocations and RSS per algorithm and event with the "
+    "AllocationAuditor and write them to allocation_trace.csv",
+)
+opts = parser.parse_known_args()[0]
+
+
+def checkpointed_events(checkpoint_file):
+    """Get the input position up to which all events have been written according
+    to the checkpoint file of the AsyncOutputWriter, or 0 if there is none"""
+    if not os.path.exists(checkpoint_file):
+        return 0
+    with open(checkpoint_file) as checkpoint:
+        for line in checkpoint:
+            fields = shlex.split(line)
+            if fields[:1] == ["processed_events"]:
+                return int(fields[1])
+    return 0
+
 
 iosvc = IOSvc()
+if opts.checkpoint_file:
+    # Skip the events that a previous attempt of this job has already written
+    iosvc.FirstEventEntry = checkpointed_events(opts.checkpoint_file)
 
 # Configure the RecoParticleFilter to filter photons
 photon_filter = RecoParticleFilter("PhotonFilter")
@@ -28,6 +75,7 @@ gamma_gamma_finder.ResonanceMass = 0.1349766
 gamma_gamma_finder.MaxDeltaM = 0.04
 gamma_gamma_finder.MinFitProbability = 0.001
 gamma_gamma_finder.Fitter = "OPALFitter"
+gamma_gamma_finder.Topology = "GammaGamma"
 
 pi0_filter = RecoParticleFilter("Pi0Filter")
 pi0_filter.PDG = 111
@@ -35,25 +83,54 @@ pi0_filter.MinPt = 1.0
 pi0_filter.InputCollection = gamma_gamma_finder.OutputCollection
 pi0_filter.OutputCollection = ["Pi0s_New"]
 
-iosvc.Output = "pi0_candidates.root"
-iosvc.outputCommands = [
-    "drop *",
-    "keep PandoraPFOs",
-    "keep GammaGamma*",
-    "keep FilteredPhotons",
-    "keep *_New",
-    "keep MCParticles",
-    "drop *_startVertices",
-    "drop *Eta*",
+# The collections that are written, the same for both ways of writing the output
+output_collections = [
+    "PandoraPFOs",
+    "GammaGammaCandidatePi0s",
+    "GammaGammaParticles",
+    "FilteredPhotons",
+    "GammaGammaCandidates_Pi0_New",
+    "Pi0s_New",
 ]
+output_mc_collections = ["MCParticles"]
+
+output_algs = []
+if opts.async_output or opts.checkpoint_file:
+    # Events are copied at the end of processing and compressed and written on
+    # a separate thread
+    async_writer = AsyncOutputWriter("AsyncOutputWriter")
+    async_writer.InputCollections = output_collections
+    async_writer.MCParticleCollections = output_mc_collections
+    async_writer.OutputFile = "pi0_candidates.root"
+    async_writer.MaxQueueSize = 8
+    async_writer.ReorderEvents = True
+    if opts.checkpoint_file:
+        # The output is split into pi0_candidates_0000.root, ... with
+        # CheckpointInterval events each
+        async_writer.CheckpointFile = opts.checkpoint_file
+        async_writer.CheckpointInterval = opts.checkpoint_interval
+    output_algs.append(async_writer)
+else:
+    iosvc.Output = "pi0_candidates.root"
+    iosvc.outputCommands = ["drop *"] + [
+        f"keep {name}" for name in output_collections + output_mc_collections
+    ]
 
 # Use Gaudi Auditor service to get timing information on algorithm execution
 auditorSvc = AuditorSvc()
 auditorSvc.Auditors = [AlgTimingAuditor()]
+if opts.profile_allocations:
+    # Record heap allocations and RSS per algorithm and event. Allocations are
+    # only counted if the job is run with
+    #   LD_PRELOAD=libKinfitAllocationCounter.so k4run ...
+    # otherwise only the RSS is recorded
+    allocationAuditor = AllocationAuditor()
+    allocationAuditor.TraceFile = "allocation_trace.csv"
+    auditorSvc.Auditors += [allocationAuditor]
 
 # Configure the application manager
 app_mgr = ApplicationMgr(
-    TopAlg=[photon_filter, gamma_gamma_finder, pi0_filter],
+    TopAlg=[photon_filter, gamma_gamma_finder, pi0_filter] + output_algs,
     EvtSel="NONE",
     EvtMax=-1,
     ExtSvc=[EventDataSvc(), auditorSvc],
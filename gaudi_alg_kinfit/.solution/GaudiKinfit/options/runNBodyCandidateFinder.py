@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+
+from Gaudi.Configuration import INFO
+from k4FWCore import ApplicationMgr, IOSvc
+from Configurables import (
+    RecoParticleFilter,
+    GammaGammaCandidateFinder,
+    NBodyCandidateFinder,
+    EventDataSvc,
+)
+
+iosvc = IOSvc()
+
+# Configure the RecoParticleFilter to filter photons
+photon_filter = RecoParticleFilter("PhotonFilter")
+photon_filter.PDG = 22  # Photon PDG ID
+photon_filter.MinE = 0.5  # Minimum energy in GeV
+photon_filter.InputCollection = ["PandoraPFOs"]
+photon_filter.OutputCollection = ["FilteredPhotons"]
+
+# Build the pi0 candidates that are used as daughters below
+gamma_gamma_finder = GammaGammaCandidateFinder("GammaGammaFinder")
+gamma_gamma_finder.InputCollection = photon_filter.OutputCollection
+gamma_gamma_finder.OutputCollection = ["GammaGammaCandidates_Pi0_New"]
+gamma_gamma_finder.ResonancePDG = 111
+gamma_gamma_finder.ResonanceMass = 0.1349766
+gamma_gamma_finder.MaxDeltaM = 0.04
+gamma_gamma_finder.MinFitProbability = 0.001
+gamma_gamma_finder.Fitter = "OPALFitter"
+gamma_gamma_finder.Topology = "GammaGamma"
+
+# Combine three pi0 candidates into eta -> pi0 pi0 pi0 candidates. The pi0s are
+# resolved into their photons for the fit and their masses are constrained in
+# addition to the eta mass. Other decays can be configured by adding more input
+# collections, e.g. for omega -> pi+ pi- pi0 with the charged pions as first
+# and the pi0s as second input:
+#   InputCollections = ["ChargedPions", "GammaGammaCandidates_Pi0_New"]
+#   DaughterInputs = [0, 0, 1]
+#   ResonancePDG = 223
+#   ResonanceMass = 0.78266
+three_pi0_finder = NBodyCandidateFinder("ThreePi0Finder")
+three_pi0_finder.InputCollections = gamma_gamma_finder.OutputCollection
+three_pi0_finder.OutputCollection = ["ThreePi0Candidates_New"]
+three_pi0_finder.DaughterInputs = [0, 0, 0]
+three_pi0_finder.ResonancePDG = 221
+three_pi0_finder.ResonanceMass = 0.547862
+three_pi0_finder.MaxDeltaM = 0.1
+three_pi0_finder.TotalCharge = 0
+three_pi0_finder.ConstrainDaughterMasses = True
+three_pi0_finder.MinFitProbability = 0.001
+three_pi0_finder.Fitter = "OPALFitter"
+
+iosvc.Output = "three_pi0_candidates.root"
+iosvc.outputCommands = [
+    "drop *",
+    "keep FilteredPhotons",
+    "keep *_New",
+    "keep MCParticles",
+    "drop *_startVertices",
+]
+
+# Configure the application manager
+app_mgr = ApplicationMgr(
+    TopAlg=[photon_filter, gamma_gamma_finder, three_pi0_finder],
+    EvtSel="NONE",
+    EvtMax=-1,
+    ExtSvc=[EventDataSvc()],
+    OutputLevel=INFO,
+)
@@ -1,38 +1,55 @@
 #include <TFile.h>
-#include <TH1D.h>
-#include <TLorentzVector.h>
 
 #include "podio/Frame.h"
 #include "podio/Reader.h"
 
 #include "edm4hep/ReconstructedParticleCollection.h"
-#include "edm4hep/utils/kinematics.h"
 
-#include <iostream>
-#include <string>
+#include "GaudiKinfit/Histograms.h"
+#include "GaudiKinfit/HistogramsROOT.h"
+#include "GaudiKinfit/IncrementalCache.h"
+#include "GaudiKinfit/Pi0Binning.h"
 
-int main(int argc, char* argv[]) {
-  if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " <inputfile> [outputfile]" << std::endl;
-    return 1;
-  }
+#include "resolved_daughters.h"
 
-  std::string outputfile = "pi0_histograms_cpp.root";
-  if (argc == 3) {
-    outputfile = argv[2];
-  }
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hist = kinfit::hist;
+
+/// Increase whenever the way the histograms are filled changes, to invalidate
+/// the results in existing caches (changes to the booking are detected
+/// automatically)
+constexpr int fillVersion = 1;
+
+/// The histograms, they are only converted to ROOT histograms at the end
+struct Pi0Histograms {
+  hist::Histogram1D pi0_mass{"pi0_mass", ";M_{#pi^{0}};Entries", hist::pi0::mass};
+  hist::Histogram1D pi0_mass_p4{"pi0_p4", ";M_{#gamma#gamma};Entries", hist::pi0::mass};
+  hist::Histogram1D pi0_mass_prefit{"pi0_mass_prefit", ";M_{#gamma#gamma} (prefit);Entries",
+                                    hist::pi0::prefitMass};
+  hist::Histogram1D fit_delta_m{"fit_delta_m", ";M_{#gamma#gamma} (postfit) - M_{#gamma#gamma} (prefit);Entries",
+                                hist::pi0::fitDeltaM};
+};
+
+/// The definitions of the histograms for the IncrementalCache
+std::string histogramDefinitions() {
+  const auto histograms = Pi0Histograms{};
+  auto definitions = std::ostringstream{};
+  definitions << "fill_version " << fillVersion << '\n';
+  hist::writeHistograms(definitions, histograms.pi0_mass, histograms.pi0_mass_p4, histograms.pi0_mass_prefit,
+                        histograms.fit_delta_m);
+  return definitions.str();
+}
 
+std::vector<hist::AnyHistogram> fillHistograms(const std::string& inputfile) {
   // Open input file
-  auto reader = podio::makeReader(argv[1]);
-
-  // Create output file and histograms
-  auto histfile = std::make_unique<TFile>(outputfile.c_str(), "recreate");
+  auto reader = podio::makeReader(inputfile);
 
-  auto pi0_mass = TH1D("pi0_mass", ";M_{#pi^{0}};Entries", 100, 0.130, 0.139);
-  auto pi0_mass_p4 = TH1D("pi0_p4", ";M_{#gamma#gamma};Entries", 100, 0.130, 0.139);
-  auto pi0_mass_prefit = TH1D("pi0_mass_prefit", ";M_{#gamma#gamma} (prefit);Entries", 100, 0.1, 0.19);
-  auto fit_delta_m =
-      TH1D("fit_delta_m", ";M_{#gamma#gamma} (postfit) - M_{#gamma#gamma} (prefit);Entries", 100, -0.1, 0.1);
+  auto [pi0_mass, pi0_mass_p4, pi0_mass_prefit, fit_delta_m] = Pi0Histograms{};
 
   // Process events
   unsigned int nEvents = reader.getEntries("events");
@@ -41,31 +58,81 @@ int main(int argc, char* argv[]) {
 
     const auto& pi0s = event.get<edm4hep::ReconstructedParticleCollection>("Pi0s_New");
 
-    for (const auto& pi0 : pi0s) {
-      pi0_mass.Fill(pi0.getMass());
+    // Resolve all daughters once and compute the masses in flat loops over
+    // contiguous buffers, instead of chasing the relations per candidate
+    const auto resolved = resolveDaughters(pi0s);
+    const auto postfitMasses = parentMasses(resolved);
+    const auto prefitMasses = daughterMasses(resolved);
+
+    for (size_t j = 0; j < pi0s.size(); ++j) {
+      pi0_mass.fill(pi0s[j].getMass());
+      pi0_mass_p4.fill(postfitMasses[j]);
+      pi0_mass_prefit.fill(prefitMasses[j]);
+      fit_delta_m.fill(postfitMasses[j] - prefitMasses[j]);
+    }
+  }
 
-      auto pi0_p4 = edm4hep::utils::p4(pi0, edm4hep::utils::UseEnergy);
-      pi0_mass_p4.Fill(pi0_p4.M());
+  auto histograms = std::vector<hist::AnyHistogram>{};
+  histograms.emplace_back(std::move(pi0_mass));
+  histograms.emplace_back(std::move(pi0_mass_p4));
+  histograms.emplace_back(std::move(pi0_mass_prefit));
+  histograms.emplace_back(std::move(fit_delta_m));
+  return histograms;
+}
 
-      auto particles = pi0.getParticles();
-      auto gamma1_p4 = edm4hep::utils::p4(particles[0], edm4hep::utils::UseEnergy);
-      auto gamma2_p4 = edm4hep::utils::p4(particles[1], edm4hep::utils::UseEnergy);
-      auto prefit_pi0 = gamma1_p4 + gamma2_p4;
+int main(int argc, char* argv[]) {
+  if (argc < 2 || (std::strcmp(argv[1], "--cache-dir") == 0 && argc < 5)) {
+    std::cerr << "Usage: " << argv[0] << " <inputfile> [outputfile]\n"
+              << "       " << argv[0] << " --cache-dir <cachedir> [--prune] <outputfile> <inputfiles...>\n\n"
+              << "With --cache-dir the partial histograms of every input file are cached together with a\n"
+              << "checksum of the file, and only new or changed input files are processed on a re-run.\n"
+              << "With --prune all cached results of files that are not passed in this run are removed"
+              << std::endl;
+    return 1;
+  }
 
-      pi0_mass_prefit.Fill(prefit_pi0.M());
-      fit_delta_m.Fill(pi0_p4.M() - prefit_pi0.M());
+  if (std::strcmp(argv[1], "--cache-dir") != 0) {
+    std::string outputfile = "pi0_histograms_cpp.root";
+    if (argc == 3) {
+      outputfile = argv[2];
     }
+
+    const auto histograms = fillHistograms(argv[1]);
+
+    // Write histograms
+    auto histfile = std::make_unique<TFile>(outputfile.c_str(), "recreate");
+    hist::writeToROOT(histograms);
+    histfile->Close();
+
+    std::cout << "Analysis complete. Output written to " << outputfile << std::endl;
+
+    return 0;
   }
 
-  // Write histograms
-  pi0_mass.Write();
-  pi0_mass_p4.Write();
-  pi0_mass_prefit.Write();
-  fit_delta_m.Write();
+  const bool prune = std::strcmp(argv[3], "--prune") == 0;
+  if (prune && argc < 6) {
+    std::cerr << "No input files given" << std::endl;
+    return 1;
+  }
+  const std::string outputfile = argv[3 + prune];
+  const auto inputfiles = std::vector<std::string>(argv + 4 + prune, argv + argc);
+
+  auto cache = IncrementalCache(argv[2], histogramDefinitions());
+  if (cache.invalidated()) {
+    std::cout << "The histogram definitions have changed, dropped all cached results in " << argv[2] << std::endl;
+  }
+  auto histograms = std::vector<hist::AnyHistogram>{};
+  for (const auto& inputfile : inputfiles) {
+    hist::mergeHistograms(histograms, cache.get(inputfile, fillHistograms));
+  }
+  cache.writeManifest(inputfiles, prune);
 
+  auto histfile = std::make_unique<TFile>(outputfile.c_str(), "recreate");
+  hist::writeToROOT(histograms);
   histfile->Close();
 
-  std::cout << "Analysis complete. Output written to " << outputfile << std::endl;
+  std::cout << "Analysis complete. Processed " << cache.nProcessed() << " new or changed files and reused "
+            << cache.nCached() << " cached results. Output written to " << outputfile << std::endl;
 
   return 0;
 }
@@ -0,0 +1,37 @@
+#include <TFile.h>
+
+#include "GaudiKinfit/Histograms.h"
+#include "GaudiKinfit/HistogramsROOT.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Merge the histogram state files written by several jobs (e.g. via the
+// HistogramStateFile property of the GammaGammaCandidateFinder) and convert
+// the result into ROOT histograms
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <outputfile> <statefile> [statefiles...]" << std::endl;
+    return 1;
+  }
+
+  auto merged = std::vector<kinfit::hist::AnyHistogram>{};
+  for (int i = 2; i < argc; ++i) {
+    auto stateFile = std::ifstream(argv[i]);
+    if (!stateFile) {
+      std::cerr << "Could not open histogram state file " << argv[i] << std::endl;
+      return 1;
+    }
+    kinfit::hist::mergeHistograms(merged, kinfit::hist::readHistograms(stateFile));
+  }
+
+  auto histfile = std::make_unique<TFile>(argv[1], "recreate");
+  kinfit::hist::writeToROOT(merged);
+  histfile->Close();
+
+  std::cout << "Merged " << argc - 2 << " files. Output written to " << argv[1] << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <edm4hep/ReconstructedParticleCollection.h>
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// Contiguous (structure of arrays) storage for a set of four momenta
+struct FourMomentumBuffer {
+  std::vector<double> px;
+  std::vector<double> py;
+  std::vector<double> pz;
+  std::vector<double> e;
+
+  void resize(std::size_t n) {
+    px.resize(n);
+    py.resize(n);
+    pz.resize(n);
+    e.resize(n);
+  }
+
+  std::size_t size() const { return e.size(); }
+};
+
+/// The four momenta of a collection of candidates and of their daughters,
+/// resolved in one pass over the collection. The daughters of candidate i are
+/// stored at [i * nDaughters, (i + 1) * nDaughters) in the daughters buffer
+struct ResolvedDaughters {
+  std::size_t nDaughters{};
+  FourMomentumBuffer parents;
+  FourMomentumBuffer daughters;
+};
+
+/// Resolve the OneToMany particles relation of all candidates in one go.
+///
+/// Only the first nDaughters daughters are considered, and candidates with
+/// fewer daughters are considered an error
+inline ResolvedDaughters resolveDaughters(const edm4hep::ReconstructedParticleCollection& candidates,
+                                          std::size_t nDaughters = 2) {
+  ResolvedDaughters resolved{nDaughters, {}, {}};
+  resolved.parents.resize(candidates.size());
+  resolved.daughters.resize(candidates.size() * nDaughters);
+
+  auto& parents = resolved.parents;
+  auto& daughters = resolved.daughters;
+
+  for (std::size_t i = 0; i < candidates.size(); ++i) {
+    const auto candidate = candidates[i];
+    const auto mom = candidate.getMomentum();
+    parents.px[i] = mom.x;
+    parents.py[i] = mom.y;
+    parents.pz[i] = mom.z;
+    parents.e[i] = candidate.getEnergy();
+
+    const auto particles = candidate.getParticles();
+    if (particles.size() < nDaughters) {
+      throw std::invalid_argument("Candidate " + std::to_string(i) + " has only " +
+                                  std::to_string(particles.size()) + " daughters, expected " +
+                                  std::to_string(nDaughters));
+    }
+    for (std::size_t j = 0; j < nDaughters; ++j) {
+      const auto daughter = particles[j];
+      const auto dMom = daughter.getMomentum();
+      const auto k = i * nDaughters + j;
+      daughters.px[k] = dMom.x;
+      daughters.py[k] = dMom.y;
+      daughters.pz[k] = dMom.z;
+      daughters.e[k] = daughter.getEnergy();
+    }
+  }
+
+  return resolved;
+}
+
+/// Invariant mass with the same sign convention as ROOT::Math::LorentzVector::M()
+inline double invariantMass(double px, double py, double pz, double e) {
+  const auto m2 = e * e - px * px - py * py - pz * pz;
+  return m2 < 0 ? -std::sqrt(-m2) : std::sqrt(m2);
+}
+
+/// Invariant masses of all the candidates
+inline std::vector<double> parentMasses(const ResolvedDaughters& resolved) {
+  const auto& p = resolved.parents;
+  auto masses = std::vector<double>(p.size());
+  for (std::size_t i = 0; i < p.size(); ++i) {
+    masses[i] = invariantMass(p.px[i], p.py[i], p.pz[i], p.e[i]);
+  }
+  return masses;
+}
+
+/// Invariant masses of the sum of the daughters of all candidates, i.e. the
+/// masses before any kinematic fit
+inline std::vector<double> daughterMasses(const ResolvedDaughters& resolved) {
+  const auto& d = resolved.daughters;
+  const auto n = resolved.nDaughters;
+  auto masses = std::vector<double>(resolved.parents.size());
+  for (std::size_t i = 0; i < masses.size(); ++i) {
+    double px = 0, py = 0, pz = 0, e = 0;
+    for (std::size_t j = i * n; j < (i + 1) * n; ++j) {
+      px += d.px[j];
+      py += d.py[j];
+      pz += d.pz[j];
+      e += d.e[j];
+    }
+    masses[i] = invariantMass(px, py, pz, e);
+  }
+  return masses;
+}
@@ -8,6 +8,15 @@ from Configurables import (
 from k4MarlinWrapper.parseConstants import *
 
 from k4FWCore import IOSvc
+from k4FWCore.parseArgs import parser
+
+parser.add_argument(
+    "--output-suffix",
+    default="",
+    help="Suffix for the names of all output files, e.g. to write every segment "
+    "of a job run by runResumable.py to its own files",
+)
+opts = parser.parse_known_args()[0]
 
 algList = []
 
@@ -129,6 +138,8 @@ CONSTANTS = {
     "PfoOutputFile": "%(OutputBaseName)s_PfoAnalysis.root",
 }
 
+CONSTANTS["OutputBaseName"] += opts.output_suffix
+
 parseConstants(CONSTANTS)
 
 io_svc = IOSvc()
@@ -184,7 +195,7 @@ io_svc.CollectionNames = [
     "YokeEndcapsCollection",
     "YokeEndcapsCollectionContributions",
 ]
-io_svc.Output = "zh_mumu_reco.edm4hep.root"
+io_svc.Output = f"zh_mumu_reco{opts.output_suffix}.edm4hep.root"
 io_svc.outputCommands = [
     "drop *",
     "keep MCParticlesSkimmed",
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Run a k4run job in segments of a fixed number of events, keeping track of
+the completed segments in a checkpoint file. If the job is interrupted (e.g. a
+preempted batch job), running the same command again continues with the first
+segment that has not been completed, instead of starting from event 0.
+
+Every segment writes its own output files, distinguished by the --output-suffix
+that is passed to the options file (see MarlinStdReco.py). A segment is only
+recorded in the checkpoint once k4run has finished successfully, so all files
+of the recorded segments are complete.
+
+The price for this is the initialization of the job (geometry, conditions,
+...) for every segment. The time spent in each segment is reported at the end,
+choose the --checkpoint-interval such that the initialization stays small
+compared to the processing time of a segment.
+"""
+
+import argparse
+import os
+import shlex
+import subprocess
+import sys
+import time
+
+from podio.reading import get_reader
+
+
+def read_checkpoint(checkpoint_file):
+    """Get the number of processed events and the suffixes of the completed
+    segments from the checkpoint file"""
+    processed_events = 0
+    segments = []
+    if os.path.exists(checkpoint_file):
+        with open(checkpoint_file) as checkpoint:
+            for line in checkpoint:
+                fields = shlex.split(line)
+                if fields[:1] == ["processed_events"]:
+                    processed_events = int(fields[1])
+                elif fields[:1] == ["segment"]:
+                    segments.append(fields[1])
+    return processed_events, segments
+
+
+def write_checkpoint(checkpoint_file, processed_events, segments):
+    """Write the checkpoint via a temporary file, such that there is always a
+    complete checkpoint even if the job is killed while writing it"""
+    tmp_file = f"{checkpoint_file}.tmp"
+    with open(tmp_file, "w") as checkpoint:
+        checkpoint.write(f"processed_events {processed_events}\n")
+        for segment in segments:
+            checkpoint.write(f"segment {shlex.quote(segment)}\n")
+    os.replace(tmp_file, checkpoint_file)
+
+
+def main(args, k4run_args):
+    """Main"""
+    n_events = len(get_reader(args.inputfile).get("events"))
+    if args.num_events >= 0:
+        n_events = min(n_events, args.num_events)
+
+    processed_events, segments = read_checkpoint(args.checkpoint_file)
+    if processed_events > 0:
+        print(
+            f"Resuming from {args.checkpoint_file}: {processed_events} of {n_events} "
+            f"events have been processed in {len(segments)} segments"
+        )
+
+    segment_times = []
+    while processed_events < n_events:
+        suffix = f"_{len(segments):04d}"
+        segment_events = min(args.checkpoint_interval, n_events - processed_events)
+        cmd = [
+            "k4run",
+            args.options,
+            f"--IOSvc.Input={args.inputfile}",
+            f"--IOSvc.FirstEventEntry={processed_events}",
+            f"--num-events={segment_events}",
+            f"--output-suffix={suffix}",
+        ] + k4run_args
+
+        last_event = processed_events + segment_events - 1
+        print(f"Processing events {processed_events} to {last_event}", flush=True)
+        start = time.monotonic()
+        result = subprocess.run(cmd)
+        if result.returncode != 0:
+            print(
+                f"k4run failed with exit code {result.returncode}, "
+                "the checkpoint has not been updated"
+            )
+            return result.returncode
+        segment_times.append((suffix, segment_events, time.monotonic() - start))
+
+        processed_events += segment_events
+        segments.append(suffix)
+        write_checkpoint(args.checkpoint_file, processed_events, segments)
+
+    if segment_times:
+        print("Segment    Events    Time (s)    Time / event (s)")
+        for segment, events, seconds in segment_times:
+            time_per_event = seconds / events
+            print(
+                f"{segment:>7}    {events:6d}    "
+                f"{seconds:8.1f}    {time_per_event:16.3f}"
+            )
+        total_events = sum(events for _, events, _ in segment_times)
+        total_seconds = sum(seconds for _, _, seconds in segment_times)
+        print(f"Processed {total_events} events in {total_seconds:.1f} s")
+    print(
+        f"All {n_events} events have been processed, "
+        f"the outputs are in {len(segments)} segments"
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description=__doc__.split("\n\n")[0],
+        epilog="All further arguments are passed to k4run",
+    )
+    parser.add_argument(
+        "options", help="The options file to run, e.g. MarlinStdReco.py"
+    )
+    parser.add_argument("inputfile", help="The input file")
+    parser.add_argument(
+        "--checkpoint-file", required=True, help="The file to store the progress in"
+    )
+    parser.add_argument(
+        "--checkpoint-interval",
+        type=int,
+        default=100,
+        help="Number of events per segment (default: %(default)s)",
+    )
+    parser.add_argument(
+        "-n",
+        "--num-events",
+        type=int,
+        default=-1,
+        help="Total number of events to process (default: all)",
+    )
+
+    args, k4run_args = parser.parse_known_args()
+    sys.exit(main(args, k4run_args))